@@ -2,6 +2,30 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <cmath>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#define SHARDING_SUPPORTED 1
+#define QUERY_SERVER_SUPPORTED 1
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS has none; connections set SO_NOSIGPIPE instead
+#endif
+#endif
 using namespace std;
 
 const int MAX_NODES = 26;  // 26 nodes (A to Z)
@@ -16,6 +40,41 @@ const string FILE_PATHS[] = {
 
 
 const int CONGESTION_THRESHOLD = 20; // Threshold for congestion, can be adjusted
+const int ROAD_QUEUE_VEHICLES_PER_UNIT = 2; // Queue slots per unit of road length
+const int SATURATION_HEADWAY = 2;           // Seconds of green needed per vehicle leaving a road
+const int SIGNAL_SECONDS_PER_TICK = 30;     // Simulated seconds in one vehicle movement pass
+const int MAX_ALTERNATIVE_ROUTES = 3;      // Routes offered to vehicles rerouted around congestion
+const int ROUTE_PENALTY_PERCENT = 50;      // Extra cost put on roads of an already found route
+const int MAX_ROUTE_STRETCH_PERCENT = 150; // Alternatives may cost at most 1.5x the best route
+const int MAX_ROUTE_OVERLAP_PERCENT = 70;  // Alternatives may share at most 70% of their cost with another route
+
+// Traffic assignment (BPR volume-delay: t = t0 * (1 + alpha * (volume / capacity)^beta))
+const double BPR_ALPHA = 0.15;
+const double BPR_BETA = 4.0;
+const double ROAD_CAPACITY = CONGESTION_THRESHOLD; // Vehicles a road carries before delays grow quickly
+const int ASSIGNMENT_MAX_ITERATIONS = 100;
+const double ASSIGNMENT_GAP_TOLERANCE = 0.0001;     // Stop once the relative gap is this small
+
+const unsigned long long DEFAULT_SIMULATION_SEED = 20241215ULL; // Seed for all random streams
+const string CHECKPOINT_FILE = "simulation.ckpt";
+const unsigned int CHECKPOINT_VERSION = 4;
+
+const string TRAJECTORY_FILE = "trajectories.tmst";
+const int TRAJECTORY_TICKS_PER_ROW_GROUP = 64; // Ticks buffered before a background flush
+
+const string ROUTE_SERVER_SOCKET = "tms_routes.sock";
+const int ROUTE_SERVER_THREADS = 8;          // Worker threads answering requests
+const int ROUTE_SERVER_MAX_CLIENTS = 128;    // Open connections; further ones are turned away
+const int ROUTE_SERVER_LATENCY_SAMPLES = 8192; // Most recent request latencies kept for percentiles
+
+const int MAX_SHARDS = 8;                  // Processes the network can be split across
+const int PARTITION_IMBALANCE_PERCENT = 110; // A partition may hold 10% more intersections than its share
+
+enum RouteMetric {
+    SHORTEST_DISTANCE,
+    FASTEST_TIME,      // Road length plus congestion delay
+    SIGNAL_AWARE_TIME  // Fastest time plus waiting at red signals along the way
+};
 
 class TrafficManagementSystem {
 private:
@@ -76,10 +135,114 @@ private:
         }
     };
 
+    struct Route {
+        int nodes[MAX_NODES]; // Intersections from source to destination
+        int edges[MAX_NODES]; // Road taken from nodes[i], as an index into its adjacency list
+        int nodeCount;
+        int cost;             // Total distance or time, without any route penalties
+    };
+
+    // Scratch space for one route search. Values are only valid when their
+    // stamp equals the current generation, so starting a new search is a
+    // single increment instead of clearing every array. The frontier is a
+    // binary heap with room for one entry per road, so a search never
+    // allocates. Cost is the metric's cost type.
+    template <typename Cost>
+    struct SearchWorkspace {
+        struct HeapEntry {
+            Cost dist;
+            int node;
+        };
+
+        Cost dist[MAX_NODES];
+        int prev[MAX_NODES];
+        int prevEdge[MAX_NODES];
+        unsigned int reached[MAX_NODES]; // Generation in which dist/prev were set
+        unsigned int settled[MAX_NODES]; // Generation in which the node was finalized
+        unsigned int generation;
+        HeapEntry heap[MAX_NODES * MAX_NODES + 1];
+        int heapSize;
+
+        SearchWorkspace() : generation(0), heapSize(0) {
+            for (int i = 0; i < MAX_NODES; ++i) {
+                reached[i] = settled[i] = 0;
+            }
+        }
+
+        void reset() {
+            heapSize = 0;
+            if (++generation == 0) { // Stamps wrapped around, clear them once
+                for (int i = 0; i < MAX_NODES; ++i) {
+                    reached[i] = settled[i] = 0;
+                }
+                generation = 1;
+            }
+        }
+
+        static Cost unreachable() {
+            return numeric_limits<Cost>::max() / 2;
+        }
+
+        Cost distance(int node) const {
+            return reached[node] == generation ? dist[node] : unreachable();
+        }
+
+        bool isSettled(int node) const {
+            return settled[node] == generation;
+        }
+
+        void relax(int node, Cost newDist, int from, int edge) {
+            reached[node] = generation;
+            dist[node] = newDist;
+            prev[node] = from;
+            prevEdge[node] = edge;
+            int i = heapSize++;
+            while (i > 0 && heap[(i - 1) / 2].dist > newDist) {
+                heap[i] = heap[(i - 1) / 2];
+                i = (i - 1) / 2;
+            }
+            heap[i] = { newDist, node };
+        }
+
+        // Next closest unsettled node, or -1 when the frontier is empty
+        int popClosest() {
+            while (heapSize > 0) {
+                HeapEntry top = heap[0];
+                HeapEntry last = heap[--heapSize];
+                int i = 0;
+                while (2 * i + 1 < heapSize) {
+                    int child = 2 * i + 1;
+                    if (child + 1 < heapSize && heap[child + 1].dist < heap[child].dist) child++;
+                    if (heap[child].dist >= last.dist) break;
+                    heap[i] = heap[child];
+                    i = child;
+                }
+                heap[i] = last;
+
+                // Skip entries left behind by later improvements
+                if (!isSettled(top.node) && top.dist == dist[top.node]) {
+                    settled[top.node] = generation;
+                    return top.node;
+                }
+            }
+            return -1;
+        }
+    };
+
+    // One workspace per thread and cost type, reused by every search on that thread
+    template <typename Cost>
+    static SearchWorkspace<Cost>& searchWorkspace() {
+        thread_local SearchWorkspace<Cost> workspace;
+        return workspace;
+    }
+
     struct Vehicle {
         string id;
         int currentNode;  // The current node (intersection) of the vehicle
         int destinationNode; // Destination intersection
+        int roadTo = -1;      // Queued on the road currentNode -> roadTo, -1 while at the intersection
+        int enteredTick = -1; // Tick in which it joined that road's queue
+        Route plannedRoute = {}; // Alternative route being followed, nodeCount 0 when none
     };
 
 
@@ -166,6 +329,8 @@ private:
             if (vehicles[i].id == vehicleId) {
                 found = true;
 
+                removeFromRoadQueues(i);
+
                 // Shift all vehicles after the removed vehicle to the left
                 for (int j = i; j < vehicleCount - 1; ++j) {
                     vehicles[j] = vehicles[j + 1];
@@ -238,20 +403,62 @@ private:
         }
     }
 
+    // Small xorshift64* generator. Every component owns its own stream so a run
+    // only depends on the seed and its whole state fits in one integer.
+    struct RandomStream {
+        unsigned long long state;
+
+        RandomStream() : state(1) {}
+
+        // Streams with the same seed but different ids are independent
+        void seed(unsigned long long seedValue, unsigned long long streamId) {
+            unsigned long long z = seedValue + (streamId + 1) * 0x9E3779B97F4A7C15ULL; // splitmix64
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            state = (z ^ (z >> 31)) | 1; // Never zero
+        }
+
+        unsigned int next() {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return (unsigned int)((state * 0x2545F4914F6CDD1DULL) >> 32);
+        }
+    };
+
     struct TrafficSignal {
-        int greenTime;  // Time duration for Green Light
+        int greenTime;  // Time duration for Green Light (of the red phase while red)
         bool isGreen;  // Traffic signal state: true = Green, false = Red
+        int phaseStart; // Simulated second the current phase began
+        RandomStream rng;
 
-        TrafficSignal() : isGreen(true), greenTime(30) {}  // Default to Green with 30s duration
+        TrafficSignal() : greenTime(30), isGreen(true), phaseStart(0) {}  // Default to Green with 30s duration
 
         void toggle() {
             isGreen = !isGreen;
             if (isGreen) {
-                greenTime = (rand() % 40) + 15;  // Random green time between 15s and 55s
+                greenTime = (rng.next() % 40) + 15;  // Random green time between 15s and 55s
             }
             else {
-                greenTime = (rand() % 20) + 10;  // Random red time between 10s and 30s
+                greenTime = (rng.next() % 20) + 10;  // Random red time between 10s and 30s
+            }
+        }
+
+        // Runs the signal from second `from` to `to`, switching phase each time
+        // one ends, and returns how many of those seconds were green
+        int advance(int from, int to) {
+            int green = 0;
+            while (from < to) {
+                int phaseEnd = max(phaseStart + greenTime, from);
+                int until = min(phaseEnd, to);
+                if (isGreen) green += until - from;
+                from = until;
+                if (from == phaseEnd) {
+                    toggle();
+                    phaseStart = phaseEnd;
+                }
             }
+            return green;
         }
 
         void displayStatus(int node) {
@@ -259,37 +466,60 @@ private:
         }
     };
 
+    // The roads again as flat arrays, one slot per (node, adjacency index), so
+    // congestion-adjusted costs are computed in one pass per tick instead of
+    // on every edge relaxation of every query
+    struct EdgeCostTable {
+        int weight[MAX_NODES * MAX_NODES];
+        int occupancy[MAX_NODES * MAX_NODES]; // Vehicles at the road's destination
+        int cost[MAX_NODES * MAX_NODES];      // weight + occupancy / 10
+
+        void refresh(const Graph& graph, const int* vehicleCounts) {
+            for (int u = 0; u < MAX_NODES; ++u) {
+                const DynamicArray& edges = graph.getEdges(u);
+                for (int i = 0; i < MAX_NODES; ++i) {
+                    int slot = u * MAX_NODES + i;
+                    weight[slot] = i < edges.getSize() ? edges[i].weight : 0;
+                    occupancy[slot] = i < edges.getSize() ? min(max(vehicleCounts[edges[i].destination], 0), 16383) : 0;
+                }
+            }
+            computeCosts();
+        }
+
+        // Branch-free over contiguous arrays so the compiler vectorizes it.
+        // occupancy / 10 is written as (occupancy * 6554) >> 16, which is exact
+        // for 0..16388, because SIMD units have no integer divide.
+        void computeCosts() {
+            for (int slot = 0; slot < MAX_NODES * MAX_NODES; ++slot) {
+                cost[slot] = weight[slot] + ((occupancy[slot] * 6554) >> 16);
+            }
+        }
+    };
+
     Graph graph;
     int vehicleCounts[MAX_NODES]; // 2D array to store vehicle counts for each road
+    EdgeCostTable edgeCosts;      // Refreshed whenever a snapshot is published
     TrafficSignal signals[MAX_NODES];  // Array to hold traffic signals at each node
 
     BlockedRoad blockedRoads[100];
     int blockedCount;
 
-    void initializeArray(int* arr, int size, int value) {
-        for (int i = 0; i < size; ++i) {
-            arr[i] = value;
+    unsigned long long simulationSeed = DEFAULT_SIMULATION_SEED;
+    int simulationTick = 0; // Completed vehicle movement passes
+
+    void seedRandomStreams(unsigned long long seedValue) {
+        simulationSeed = seedValue;
+        for (int i = 0; i < MAX_NODES; ++i) {
+            signals[i].rng.seed(seedValue, i);
         }
     }
 
-    void initializeBoolArray(bool* arr, int size, bool value) {
+    void initializeArray(int* arr, int size, int value) {
         for (int i = 0; i < size; ++i) {
             arr[i] = value;
         }
     }
 
-    int findMinDistance(int* dist, bool* visited, int nodes) {
-        int minDist = 1000000000;  // A large value for infinity
-        int minIndex = -1;
-        for (int i = 0; i < nodes; ++i) {
-            if (!visited[i] && dist[i] < minDist) {
-                minDist = dist[i];
-                minIndex = i;
-            }
-        }
-        return minIndex;
-    }
-
     void initializeBlockedRoads() {
         blockedCount = 0;
     }
@@ -361,16 +591,6 @@ private:
         }
     }
 
-    void updateVehicleCounts(int src, int dest, int delta) {
-        // Update vehicle counts for the road segment (src -> dest)
-        for (int i = 0; i < graph.getEdges(src).getSize(); ++i) {
-            if (graph.getEdges(src)[i].destination == dest) {
-                vehicleCounts[src] += delta;
-                break;
-            }
-        }
-    }
-
     void detectCongestion() {
         cout << "\nCongestion Status\n";
         bool isCongested = false;
@@ -378,10 +598,12 @@ private:
         for (int i = 0; i < MAX_NODES; ++i) {
             for (int j = 0; j < graph.getEdges(i).getSize(); ++j) {
                 int dest = graph.getEdges(i)[j].destination;
-                int count = vehicleCounts[i];
-                if (count > CONGESTION_THRESHOLD) {
+                const Queue& queue = roadQueues[i][dest];
+                int count = queue.getSize();
+                if (count > CONGESTION_THRESHOLD || (count > 0 && queue.isFull())) {
                     cout << "Road " << char(BASE_CHAR + i) << " -> " << char(BASE_CHAR + dest)
-                        << " is congested with " << count << " vehicles.\n";
+                        << " is congested with " << count << " vehicles"
+                        << (queue.isFull() ? " and is spilling back" : "") << ".\n";
                     isCongested = true;
                 }
             }
@@ -392,104 +614,499 @@ private:
         }
     }
 
-    void dijkstra(int src, int dest, bool useTime) {
-        int dist[MAX_NODES];
-        bool visited[MAX_NODES];
-        int prev[MAX_NODES]; // To store the path
+    void dijkstra(int src, int dest, RouteMetric metric) {
+        Route route;
+        bool found;
+        if (metric == SIGNAL_AWARE_TIME) {
+            // Signals have been run up to the start of the next tick
+            found = findRoute(graph, SignalAwareTimeMetric(edgeCosts, signals, simulationTick * SIGNAL_SECONDS_PER_TICK),
+                OpenRoads(), src, dest, route);
+        }
+        else {
+            found = computeRoute(src, dest, metric == FASTEST_TIME, route);
+        }
+        if (!found) {
+            cout << "No path found from " << char(BASE_CHAR + src) << " to " << char(BASE_CHAR + dest) << ".\n";
+            return;
+        }
 
-        initializeArray(dist, MAX_NODES, 1000000000); // Initialize distances to infinity
-        initializeBoolArray(visited, MAX_NODES, false); // Initialize visited nodes
-        initializeArray(prev, MAX_NODES, -1); // Initialize previous nodes for path reconstruction
+        // Print the shortest/fastest path
+        bool isTime = metric != SHORTEST_DISTANCE;
+        cout << (isTime ? "Fastest" : "Shortest") << " path from " << char(BASE_CHAR + src) << " to " << char(BASE_CHAR + dest) << ":\n";
+        printRoute(route);
+        cout << " with total " << (isTime ? "time: " : "distance: ") << route.cost << "\n";
+    }
 
-        dist[src] = 0;
 
-        for (int count = 0; count < MAX_NODES - 1; ++count) {
-            int u = findMinDistance(dist, visited, MAX_NODES); // Get the nearest unvisited node
-            if (u == -1) break; // All reachable nodes are visited
-            visited[u] = true;
+    // Cost of the road src -> dest, or -1 if there is no such road
+    int roadCost(int src, int dest, bool useTime) {
+        const DynamicArray& edges = graph.getEdges(src);
+        for (int i = 0; i < edges.getSize(); ++i) {
+            if (edges[i].destination == dest) {
+                return useTime ? edgeCosts.cost[src * MAX_NODES + i] : edges[i].weight;
+            }
+        }
+        return -1;
+    }
 
-            // Update distances for neighbors of u
-            const DynamicArray& edges = graph.getEdges(u);
-            for (int i = 0; i < edges.getSize(); ++i) {
-                int v = edges[i].destination;
-                int weight = edges[i].weight;
+    // Fastest (useTime) or shortest route over the live network
+    bool computeRoute(int src, int dest, bool useTime, Route& route) {
+        return computeRouteOn(graph, edgeCosts, src, dest, useTime, route);
+    }
+
+    // Same over an explicit network, so it can run on a published snapshot.
+    // The flag is resolved here, once, rather than inside the search loop.
+    static bool computeRouteOn(const Graph& graph, const EdgeCostTable& costs, int src, int dest, bool useTime,
+        Route& route) {
+        if (useTime) {
+            return findRoute(graph, CongestionTimeMetric(costs), OpenRoads(), src, dest, route);
+        }
+        return findRoute(graph, DistanceMetric(graph), OpenRoads(), src, dest, route);
+    }
+
+    bool sameRoute(const Route& a, const Route& b) {
+        if (a.nodeCount != b.nodeCount) return false;
+        for (int i = 0; i < a.nodeCount; ++i) {
+            if (a.nodes[i] != b.nodes[i]) return false;
+        }
+        return true;
+    }
 
-                // Adjust weight based on time or distance
-                if (useTime) {
-                    weight += vehicleCounts[v] / 10; // Adding delay based on congestion
+    // Cost of the roads in candidate that are also used by other
+    int sharedCost(const Route& candidate, const Route& other, bool useTime) {
+        int shared = 0;
+        for (int i = 0; i + 1 < candidate.nodeCount; ++i) {
+            for (int j = 0; j + 1 < other.nodeCount; ++j) {
+                if (candidate.nodes[i] == other.nodes[j] && candidate.nodes[i + 1] == other.nodes[j + 1]) {
+                    shared += roadCost(candidate.nodes[i], candidate.nodes[i + 1], useTime);
+                    break;
                 }
+            }
+        }
+        return shared;
+    }
+
+    // Penalty method: after each route is found, the roads it uses get more
+    // expensive and the search is repeated. A candidate is kept only if it is
+    // not much longer than the best route and differs enough from the others.
+    int findAlternativeRoutes(int src, int dest, bool useTime, Route routes[], int maxRoutes) {
+        int penalty[MAX_NODES][MAX_NODES];
+        for (int i = 0; i < MAX_NODES; ++i) {
+            initializeArray(penalty[i], MAX_NODES, 0);
+        }
+
+        if (maxRoutes <= 0 || !computeRoute(src, dest, useTime, routes[0])) {
+            return 0;
+        }
+        int routeCount = 1;
+        Route candidate = routes[0];
+
+        for (int attempt = 0; attempt < maxRoutes * 3 && routeCount < maxRoutes; ++attempt) {
+            // Make the roads of the last candidate more expensive
+            for (int i = 0; i + 1 < candidate.nodeCount; ++i) {
+                int u = candidate.nodes[i];
+                int v = candidate.nodes[i + 1];
+                penalty[u][v] += roadCost(u, v, useTime) * ROUTE_PENALTY_PERCENT / 100 + 1;
+            }
 
-                if (!visited[v] && dist[u] + weight < dist[v]) {
-                    dist[v] = dist[u] + weight;
-                    prev[v] = u; // Update path
+            // Search with the penalties, but report the real cost
+            bool found = useTime
+                ? findRoute(graph, PenalizedMetric<CongestionTimeMetric>(CongestionTimeMetric(edgeCosts), penalty),
+                    OpenRoads(), CongestionTimeMetric(edgeCosts), src, dest, candidate)
+                : findRoute(graph, PenalizedMetric<DistanceMetric>(DistanceMetric(graph), penalty),
+                    OpenRoads(), DistanceMetric(graph), src, dest, candidate);
+            if (!found) break;
+
+            // Real costs do not grow steadily with the penalties, so a later
+            // candidate may still be short enough; the attempt cap ends the loop
+            if (candidate.cost * 100 > routes[0].cost * MAX_ROUTE_STRETCH_PERCENT) continue;
+
+            bool accepted = true;
+            for (int r = 0; r < routeCount && accepted; ++r) {
+                if (sameRoute(candidate, routes[r]) ||
+                    sharedCost(candidate, routes[r], useTime) * 100 > candidate.cost * MAX_ROUTE_OVERLAP_PERCENT) {
+                    accepted = false;
                 }
             }
+            if (accepted) {
+                routes[routeCount++] = candidate;
+            }
         }
+        return routeCount;
+    }
 
-        if (dist[dest] == 1000000000) {
-            cout << "No path found from " << char(BASE_CHAR + src) << " to " << char(BASE_CHAR + dest) << ".\n";
-            return;
+    // Picks the route with the lowest predicted time once the vehicles already
+    // sent this way during the current pass are taken into account. Routes
+    // whose first road is full are passed over while another one has room.
+    int chooseLeastLoadedRoute(const Route routes[], int routeCount, const int plannedLoad[]) {
+        int best = 0;
+        int bestTime = 1000000000;
+        bool bestHasRoom = false;
+        for (int r = 0; r < routeCount; ++r) {
+            bool hasRoom = !roadQueues[routes[r].nodes[0]][routes[r].nodes[1]].isFull();
+            if (bestHasRoom && !hasRoom) continue;
+            int load = 0;
+            for (int i = 1; i < routes[r].nodeCount; ++i) {
+                load += plannedLoad[routes[r].nodes[i]];
+            }
+            int predicted = routes[r].cost + load / 10;
+            if (predicted < bestTime || (hasRoom && !bestHasRoom)) {
+                bestTime = predicted;
+                best = r;
+                bestHasRoom = hasRoom;
+            }
         }
+        return best;
+    }
 
-        // Print the shortest/fastest path
-        cout << (useTime ? "Fastest" : "Shortest") << " path from " << char(BASE_CHAR + src) << " to " << char(BASE_CHAR + dest) << ":\n";
-        int curr = dest;
-        string path = "";
-        while (curr != -1) {
-            path = char(BASE_CHAR + curr) + (path.empty() ? "" : " -> ") + path;
-            curr = prev[curr];
+    void printRoute(const Route& route) {
+        for (int i = 0; i < route.nodeCount; ++i) {
+            cout << char(BASE_CHAR + route.nodes[i]) << (i + 1 < route.nodeCount ? " -> " : "");
+        }
+    }
+
+    // Next intersection on the vehicle's planned route from node, or -1 if it
+    // has none or a road on it has been closed since
+    int plannedNextNode(const Vehicle& vehicle, int node) {
+        const Route& plan = vehicle.plannedRoute;
+        for (int k = 0; k + 1 < plan.nodeCount; ++k) {
+            if (plan.nodes[k] == node) {
+                return roadCost(node, plan.nodes[k + 1], false) == -1 ? -1 : plan.nodes[k + 1];
+            }
+        }
+        return -1;
+    }
+
+    // Next intersection for a vehicle standing at node. A vehicle keeps to the
+    // alternative route it was given until it arrives or the route is cut.
+    // Otherwise, if node is congested, the vehicle is spread over alternative
+    // routes: the chosen one is returned in spread and only becomes the
+    // vehicle's plan once it actually enters the first road (followRoute).
+    // Elsewhere it takes the fastest route. Returns -1 if the destination
+    // cannot be reached.
+    int chooseNextNode(Vehicle& vehicle, int node, const int plannedLoad[], Route& spread) {
+        spread.nodeCount = 0;
+        int planned = plannedNextNode(vehicle, node);
+        if (planned != -1) {
+            return planned;
+        }
+        vehicle.plannedRoute.nodeCount = 0;
+
+        if (vehicleCounts[node] > CONGESTION_THRESHOLD) {
+            cout << "Congestion detected at " << char(BASE_CHAR + node) << ". Recalculating route...\n";
+            Route alternatives[MAX_ALTERNATIVE_ROUTES];
+            int routeCount = findAlternativeRoutes(node, vehicle.destinationNode, true,
+                alternatives, MAX_ALTERNATIVE_ROUTES);
+            if (routeCount == 0) {
+                cout << "No path found from " << char(BASE_CHAR + node) << " to "
+                    << char(BASE_CHAR + vehicle.destinationNode) << ".\n";
+                return -1;
+            }
+            spread = alternatives[chooseLeastLoadedRoute(alternatives, routeCount, plannedLoad)];
+            return spread.nodes[1];
+        }
+
+        Route route;
+        if (!computeRoute(node, vehicle.destinationNode, true, route)) {
+            return -1;
+        }
+        return route.nodes[1];
+    }
+
+    // Makes spread the plan of a vehicle that has just entered its first road,
+    // and counts it on the intersections ahead for the rest of the pass
+    void followRoute(int index, const Route& spread, int plannedLoad[]) {
+        if (spread.nodeCount == 0) return;
+        vehicles[index].plannedRoute = spread;
+        for (int n = 1; n < spread.nodeCount; ++n) {
+            plannedLoad[spread.nodes[n]]++;
         }
-        cout << path << " with total " << (useTime ? "time: " : "distance: ") << dist[dest] << "\n";
+        cout << "Vehicle " << vehicles[index].id << " rerouted: ";
+        printRoute(spread);
+        cout << " with total time: " << spread.cost << "\n";
     }
 
+    void enterRoad(int index, int from, int to) {
+        roadQueues[from][to].enqueue(index);
+        vehicles[index].currentNode = from;
+        vehicles[index].roadTo = to;
+        vehicles[index].enteredTick = simulationTick;
+    }
+
+    // Vehicles still travelling, counted at the intersection they are at or leaving
+    void recountVehicles() {
+        initializeArray(vehicleCounts, MAX_NODES, 0);
+        for (int i = 0; i < vehicleCount; ++i) {
+            if (vehicles[i].roadTo != -1 || vehicles[i].currentNode != vehicles[i].destinationNode) {
+                vehicleCounts[vehicles[i].currentNode]++;
+            }
+        }
+    }
 
+    // One tick of the queue model. The signals first run through the tick's
+    // seconds. Every road then discharges from the head of its queue as many
+    // vehicles as the green seconds at its far end during the tick allow.
+    // A vehicle only leaves if the next road on its route has room; otherwise
+    // it blocks the queue behind it, so full roads spill back upstream. A
+    // vehicle with no route left waits at the intersection instead. Then
+    // vehicles waiting at intersections join the road they need next.
     void simulateVehicleTracking() {
         cout << "Simulating vehicle movement...\n";
-        for (int i = 0; i < vehicleCount; ++i) {
-            Vehicle& vehicle = vehicles[i];
+        int plannedLoad[MAX_NODES]; // Vehicles rerouted onto each intersection during this pass
+        initializeArray(plannedLoad, MAX_NODES, 0);
 
-            cout << "Vehicle ID: " << vehicle.id
-                << " Current Node: " << char(BASE_CHAR + vehicle.currentNode)
-                << " Destination: " << char(BASE_CHAR + vehicle.destinationNode) << "\n";
+        int greenSeconds[MAX_NODES];
+        int tickStart = simulationTick * SIGNAL_SECONDS_PER_TICK;
+        for (int i = 0; i < MAX_NODES; ++i) {
+            greenSeconds[i] = signals[i].advance(tickStart, tickStart + SIGNAL_SECONDS_PER_TICK);
+        }
+
+        for (int u = 0; u < MAX_NODES; ++u) {
+            for (int v = 0; v < MAX_NODES; ++v) {
+                Queue& queue = roadQueues[u][v];
+                if (queue.isEmpty() || greenSeconds[v] == 0) continue;
+
+                for (int allowance = greenSeconds[v] / SATURATION_HEADWAY; allowance > 0 && !queue.isEmpty(); --allowance) {
+                    int index = queue.getFront();
+                    Vehicle& vehicle = vehicles[index];
+                    if (vehicle.enteredTick == simulationTick) break; // Joined this tick, as did all behind it
+
+                    if (v == vehicle.destinationNode) {
+                        queue.dequeue();
+                        vehicle.currentNode = v;
+                        vehicle.roadTo = -1;
+                        vehicle.plannedRoute.nodeCount = 0;
+                        cout << "Vehicle " << vehicle.id << " has reached its destination.\n";
+                        continue;
+                    }
+
+                    Route spread;
+                    int nextNode = chooseNextNode(vehicle, v, plannedLoad, spread);
+                    if (nextNode == -1) {
+                        // No way on from here: wait at the intersection instead of blocking the road
+                        queue.dequeue();
+                        vehicle.currentNode = v;
+                        vehicle.roadTo = -1;
+                        cout << "Vehicle " << vehicle.id << " stopped at " << char(BASE_CHAR + v) << ": no route to "
+                            << char(BASE_CHAR + vehicle.destinationNode) << ".\n";
+                        continue;
+                    }
+                    if (roadQueues[v][nextNode].isFull()) {
+                        cout << "Vehicle " << vehicle.id << " held on " << char(BASE_CHAR + u) << " -> "
+                            << char(BASE_CHAR + v) << ": road to " << char(BASE_CHAR + nextNode) << " is full.\n";
+                        break;
+                    }
+                    queue.dequeue();
+                    enterRoad(index, v, nextNode);
+                    cout << "Vehicle " << vehicle.id << " moved to " << char(BASE_CHAR + v) << ".\n";
+                    followRoute(index, spread, plannedLoad);
+                }
+            }
+        }
 
-            // Check if the vehicle has reached its destination
-            if (vehicle.currentNode == vehicle.destinationNode) {
-                cout << "Vehicle " << vehicle.id << " has reached its destination.\n";
+        for (int i = 0; i < vehicleCount; ++i) {
+            Vehicle& vehicle = vehicles[i];
+            if (vehicle.roadTo != -1 || vehicle.currentNode == vehicle.destinationNode) continue;
+
+            Route spread;
+            int nextNode = chooseNextNode(vehicle, vehicle.currentNode, plannedLoad, spread);
+            if (nextNode == -1) continue;
+            if (roadQueues[vehicle.currentNode][nextNode].isFull()) {
+                cout << "Vehicle " << vehicle.id << " waiting at " << char(BASE_CHAR + vehicle.currentNode)
+                    << ": road to " << char(BASE_CHAR + nextNode) << " is full.\n";
                 continue;
             }
+            enterRoad(i, vehicle.currentNode, nextNode);
+            cout << "Vehicle " << vehicle.id << " left " << char(BASE_CHAR + vehicle.currentNode)
+                << " towards " << char(BASE_CHAR + nextNode) << ".\n";
+            followRoute(i, spread, plannedLoad);
+        }
+
+        recountVehicles();
+        simulationTick++;
+        recordTrajectoryTick();
+        publishSnapshot();
+    }
+
+
+    double bprTime(double freeFlowTime, double volume) {
+        return freeFlowTime * (1.0 + BPR_ALPHA * pow(volume / ROAD_CAPACITY, BPR_BETA));
+    }
+
+    // Dijkstra from origin to every node using the given road times; prev is
+    // -1 for the origin and for nodes it cannot reach
+    void shortestPathTree(int origin, const double times[MAX_NODES][MAX_NODES], int* prev) {
+        SearchWorkspace<double>& ws = searchWorkspace<double>();
+        runSearch(graph, TableTimeMetric(times), OpenRoads(), FullTree(), origin, ws);
+        for (int i = 0; i < MAX_NODES; ++i) {
+            prev[i] = ws.isSettled(i) ? ws.prev[i] : -1;
+        }
+    }
 
-            // Recalculate route dynamically if congestion is detected
-            if (vehicleCounts[vehicle.currentNode] > CONGESTION_THRESHOLD) {
-                cout << "Congestion detected at " << char(BASE_CHAR + vehicle.currentNode) << ". Recalculating route...\n";
-                dijkstra(vehicle.currentNode, vehicle.destinationNode, true); // Use fastest route
+    // All-or-nothing loading: every OD pair's demand goes on its current
+    // shortest path. One tree is built per origin, not per vehicle.
+    void allOrNothing(const int demand[MAX_NODES][MAX_NODES], const double times[MAX_NODES][MAX_NODES],
+        double loads[MAX_NODES][MAX_NODES]) {
+        for (int i = 0; i < MAX_NODES; ++i) {
+            for (int j = 0; j < MAX_NODES; ++j) {
+                loads[i][j] = 0;
             }
+        }
 
-            // Update vehicle counts for current movement
-            int nextNode = (vehicle.currentNode + 1) % MAX_NODES; // Simplified next node
-            updateVehicleCounts(vehicle.currentNode, nextNode, -1); // Decrement count at current node
-            vehicle.currentNode = nextNode;
-            updateVehicleCounts(vehicle.currentNode, nextNode, 1); // Increment count at the new node
+        int prev[MAX_NODES];
+        for (int origin = 0; origin < MAX_NODES; ++origin) {
+            bool hasDemand = false;
+            for (int d = 0; d < MAX_NODES && !hasDemand; ++d) {
+                hasDemand = demand[origin][d] > 0;
+            }
+            if (!hasDemand) continue;
 
-            cout << "Vehicle " << vehicle.id << " moved to " << char(BASE_CHAR + vehicle.currentNode) << ".\n";
+            shortestPathTree(origin, times, prev);
+            for (int d = 0; d < MAX_NODES; ++d) {
+                if (demand[origin][d] == 0 || prev[d] == -1) continue;
+                for (int at = d; prev[at] != -1; at = prev[at]) {
+                    loads[prev[at]][at] += demand[origin][d];
+                }
+            }
         }
     }
 
+    // Frank-Wolfe user equilibrium over the OD demand of all loaded vehicles.
+    // Each iteration loads all demand on the current shortest paths, then moves
+    // the flows towards that loading by the step that minimizes the Beckmann
+    // objective (found by bisection on its derivative).
+    void computeEquilibriumAssignment() {
+        int demand[MAX_NODES][MAX_NODES];
+        for (int i = 0; i < MAX_NODES; ++i) {
+            initializeArray(demand[i], MAX_NODES, 0);
+        }
+        int trips = 0;
+        for (int i = 0; i < vehicleCount; ++i) {
+            if (vehicles[i].currentNode != vehicles[i].destinationNode) {
+                demand[vehicles[i].currentNode][vehicles[i].destinationNode]++;
+                trips++;
+            }
+        }
+        if (trips == 0) {
+            cout << "No trips to assign.\n";
+            return;
+        }
+
+        // Free-flow time of each road is its weight; flows start at zero
+        static double freeFlow[MAX_NODES][MAX_NODES], times[MAX_NODES][MAX_NODES];
+        static double flow[MAX_NODES][MAX_NODES], target[MAX_NODES][MAX_NODES];
+        for (int i = 0; i < MAX_NODES; ++i) {
+            for (int j = 0; j < MAX_NODES; ++j) {
+                freeFlow[i][j] = times[i][j] = 0;
+                flow[i][j] = 0;
+            }
+            for (int j = 0; j < graph.getEdges(i).getSize(); ++j) {
+                Edge edge = graph.getEdges(i)[j];
+                freeFlow[i][edge.destination] = edge.weight;
+                times[i][edge.destination] = edge.weight;
+            }
+        }
+
+        allOrNothing(demand, times, flow);
+
+        double gap = 1.0;
+        int iteration = 0;
+        while (iteration < ASSIGNMENT_MAX_ITERATIONS) {
+            ++iteration;
+            for (int i = 0; i < MAX_NODES; ++i) {
+                for (int j = 0; j < graph.getEdges(i).getSize(); ++j) {
+                    int v = graph.getEdges(i)[j].destination;
+                    times[i][v] = bprTime(freeFlow[i][v], flow[i][v]);
+                }
+            }
+            allOrNothing(demand, times, target);
+
+            // Relative gap between current total travel time and the shortest possible
+            double current = 0, best = 0;
+            for (int i = 0; i < MAX_NODES; ++i) {
+                for (int j = 0; j < MAX_NODES; ++j) {
+                    current += times[i][j] * flow[i][j];
+                    best += times[i][j] * target[i][j];
+                }
+            }
+            gap = current > 0 ? (current - best) / current : 0;
+            if (gap < ASSIGNMENT_GAP_TOLERANCE) break;
+
+            double low = 0, high = 1;
+            for (int step = 0; step < 30; ++step) {
+                double lambda = (low + high) / 2;
+                double slope = 0;
+                for (int i = 0; i < MAX_NODES; ++i) {
+                    for (int j = 0; j < MAX_NODES; ++j) {
+                        double direction = target[i][j] - flow[i][j];
+                        if (direction != 0) {
+                            slope += bprTime(freeFlow[i][j], flow[i][j] + lambda * direction) * direction;
+                        }
+                    }
+                }
+                if (slope > 0) high = lambda;
+                else low = lambda;
+            }
+            double lambda = (low + high) / 2;
+            for (int i = 0; i < MAX_NODES; ++i) {
+                for (int j = 0; j < MAX_NODES; ++j) {
+                    flow[i][j] += lambda * (target[i][j] - flow[i][j]);
+                }
+            }
+        }
+
+        cout << "\nEquilibrium assignment of " << trips << " trips after " << iteration
+            << " iterations (relative gap " << gap << ")\n";
+        for (int i = 0; i < MAX_NODES; ++i) {
+            for (int j = 0; j < graph.getEdges(i).getSize(); ++j) {
+                int v = graph.getEdges(i)[j].destination;
+                if (flow[i][v] < 0.01) continue;
+                cout << "Road " << char(BASE_CHAR + i) << " -> " << char(BASE_CHAR + v)
+                    << " volume: " << flow[i][v]
+                    << " time: " << bprTime(freeFlow[i][v], flow[i][v])
+                    << " (free flow " << freeFlow[i][v] << ")\n";
+            }
+        }
+    }
 
     // Queue handling logic (basic queue class logic for managing queue)
     struct Queue {
-        int front, rear, size;
+        int front, rear, size, capacity;
         int* arr;
-        Queue(int capacity) : front(0), rear(-1), size(0) {
+
+        Queue() : front(0), rear(-1), size(0), capacity(0), arr(nullptr) {}
+
+        Queue(int capacity) : front(0), rear(-1), size(0), capacity(capacity) {
             arr = new int[capacity];
         }
 
+        Queue(const Queue& other) : front(0), rear(-1), size(0), capacity(0), arr(nullptr) {
+            *this = other;
+        }
+
+        Queue& operator=(const Queue& other) {
+            if (this == &other) return *this;
+            if (capacity != other.capacity) {
+                delete[] arr;
+                capacity = other.capacity;
+                arr = capacity > 0 ? new int[capacity] : nullptr;
+            }
+            front = other.front;
+            rear = other.rear;
+            size = other.size;
+            for (int i = 0; i < capacity; ++i) {
+                arr[i] = other.arr[i];
+            }
+            return *this;
+        }
+
         ~Queue() {
             delete[] arr;
         }
 
         void enqueue(int value) {
-            if (size < MAX_NODES) {
-                rear = (rear + 1) % MAX_NODES;
+            if (size < capacity) {
+                rear = (rear + 1) % capacity;
                 arr[rear] = value;
                 ++size;
             }
@@ -500,71 +1117,1480 @@ private:
                 throw runtime_error("Queue underflow");
             }
             int value = arr[front];
-            front = (front + 1) % MAX_NODES;
+            front = (front + 1) % capacity;
             --size;
             return value;
         }
 
-        bool isEmpty() {
+        bool isEmpty() const {
             return size == 0;
         }
 
-        int getFront() {
+        bool isFull() const {
+            return size == capacity;
+        }
+
+        int getFront() const {
             if (isEmpty()) {
                 throw runtime_error("Queue is empty");
             }
             return arr[front];
         }
 
-        int getSize() {
+        // i-th vehicle from the front
+        int at(int i) const {
+            return arr[(front + i) % capacity];
+        }
+
+        int getSize() const {
             return size;
         }
     };
 
-    // Method to load traffic signals data from file
-    void loadTrafficSignalsFromFile(const string& filePath) {
-        ifstream file(filePath);
-        if (!file.is_open()) {
-            cout << "Error: Cannot open file: " << filePath << endl;
-            return;
-        }
-        int count = 0;
-        string line;
-        getline(file, line); // Skip the header
-        while (getline(file, line)) {
-            stringstream ss(line);
-            char intersection;
-            int greenTime;
-            char comma;
-            if (ss >> intersection >> comma >> greenTime) {
-                int index = intersection - BASE_CHAR; // Convert char to index (A -> 0, B -> 1, etc.)
-                signals[index].greenTime = greenTime;
-            }
+    // Vehicles queued on each road, by index into vehicles. Buffers are sized
+    // from the road length when the road is first added and kept afterwards,
+    // so ticks never allocate.
+    Queue roadQueues[MAX_NODES][MAX_NODES];
+
+    void createRoadQueue(int src, int dest, int weight) {
+        if (roadQueues[src][dest].capacity == 0) {
+            roadQueues[src][dest] = Queue(max(1, weight * ROAD_QUEUE_VEHICLES_PER_UNIT));
         }
-        file.close();
     }
 
-public:
-    void addRoad(int src, int dest, int weight) {
-        graph.addEdge(src, dest, weight);
+    // Sends the vehicles queued on a closed road back to its start intersection
+    void emptyRoadQueue(int src, int dest) {
+        Queue& queue = roadQueues[src][dest];
+        while (!queue.isEmpty()) {
+            vehicles[queue.dequeue()].roadTo = -1;
+        }
     }
 
-    void removeRoad(int src, int dest) {
-        graph.removeEdge(src, dest);
-        graph.removeEdge(dest, src);  // Assuming bidirectional roads
+    // Drops vehicle index from every queue and renumbers the ones after it,
+    // matching the shift done when a vehicle is removed from the array
+    void removeFromRoadQueues(int index) {
+        for (int u = 0; u < MAX_NODES; ++u) {
+            for (int v = 0; v < MAX_NODES; ++v) {
+                Queue& queue = roadQueues[u][v];
+                for (int n = queue.getSize(); n > 0; --n) {
+                    int queued = queue.dequeue();
+                    if (queued != index) {
+                        queue.enqueue(queued > index ? queued - 1 : queued);
+                    }
+                }
+            }
+        }
     }
 
-    void loadRoadNetworkFromFile(const string& filePath) {
-        ifstream file(filePath);
-        if (!file.is_open()) {
-            cout << "Error: Cannot open file: " << filePath << endl;
-            return;
+    // Search kernel. One Dijkstra, specialized at compile time by:
+    //   Metric  - cost of leaving u through adjacency slot i to reach v when
+    //             setting out at time `departure`; also defines the Cost type
+    //   Closure - which roads may not be used at all
+    //   Stop    - when the search may end
+    // Each combination is its own instantiation, so the inner loop carries no
+    // runtime flags. A new metric is a new policy, not a copy of the search.
+
+    struct DistanceMetric {
+        typedef int Cost;
+        const Graph& graph;
+        DistanceMetric(const Graph& roads) : graph(roads) {}
+        int operator()(int u, int i, int, int) const { return graph.getEdges(u)[i].weight; }
+    };
+
+    // Road length plus congestion delay, precomputed once per tick
+    struct CongestionTimeMetric {
+        typedef int Cost;
+        const EdgeCostTable& costs;
+        CongestionTimeMetric(const EdgeCostTable& table) : costs(table) {}
+        int operator()(int u, int i, int, int) const { return costs.cost[u * MAX_NODES + i]; }
+    };
+
+    // Congestion time plus the wait at v's signal, with one unit of cost taken
+    // as one second. The search starts at simulated second `now`; each signal
+    // is run forward on a copy to the vehicle's arrival, and if it is red then
+    // the vehicle waits for the rest of that red phase. Signals follow their
+    // own seeded streams, so this is their actual future. Arriving later can
+    // never mean leaving earlier, which keeps Dijkstra exact on this
+    // time-dependent cost.
+    struct SignalAwareTimeMetric {
+        typedef int Cost;
+        const EdgeCostTable& costs;
+        const TrafficSignal* signals;
+        int now;
+        SignalAwareTimeMetric(const EdgeCostTable& table, const TrafficSignal* nodeSignals, int startSecond)
+            : costs(table), signals(nodeSignals), now(startSecond) {}
+        int operator()(int u, int i, int v, int departure) const {
+            int travel = costs.cost[u * MAX_NODES + i];
+            int arrival = now + departure + travel;
+            TrafficSignal signal = signals[v];
+            signal.advance(now, arrival);
+            int wait = signal.isGreen ? 0 : max(0, signal.phaseStart + signal.greenTime - arrival);
+            return travel + wait;
         }
-        string line;
-        while (getline(file, line)) {
-            stringstream ss(line);
-            char src, dest;
-            int weight;
+    };
+
+    // Road times from a [from][to] table, as used by traffic assignment
+    struct TableTimeMetric {
+        typedef double Cost;
+        const double (*times)[MAX_NODES];
+        TableTimeMetric(const double table[MAX_NODES][MAX_NODES]) : times(table) {}
+        double operator()(int u, int, int v, double) const { return times[u][v]; }
+    };
+
+    // Adds penalty[from][to] to another metric, for alternative routes
+    template <typename Base>
+    struct PenalizedMetric {
+        typedef typename Base::Cost Cost;
+        Base base;
+        const int (*penalty)[MAX_NODES];
+        PenalizedMetric(const Base& metric, const int roadPenalty[MAX_NODES][MAX_NODES])
+            : base(metric), penalty(roadPenalty) {}
+        Cost operator()(int u, int i, int v, Cost departure) const {
+            return base(u, i, v, departure) + penalty[u][v];
+        }
+    };
+
+    // Closed roads are removed from the graph, so every remaining road is open
+    struct OpenRoads {
+        bool isClosed(int, int) const { return false; }
+    };
+
+    struct StopAtTarget {
+        int target;
+        StopAtTarget(int node) : target(node) {}
+        bool isDone(int settledNode) const { return settledNode == target; }
+    };
+
+    struct FullTree {
+        bool isDone(int) const { return false; }
+    };
+
+    // Runs the search from src into ws. Returns the node the stop policy
+    // ended on, or -1 if the frontier ran out first.
+    template <typename Metric, typename Closure, typename Stop>
+    static int runSearch(const Graph& graph, const Metric& metric, const Closure& closure, const Stop& stop, int src,
+        SearchWorkspace<typename Metric::Cost>& ws) {
+        ws.reset();
+        ws.relax(src, 0, -1, -1);
+
+        int u;
+        while ((u = ws.popClosest()) != -1 && !stop.isDone(u)) {
+            const DynamicArray& edges = graph.getEdges(u);
+            for (int i = 0; i < edges.getSize(); ++i) {
+                int v = edges[i].destination;
+                if (ws.isSettled(v) || closure.isClosed(u, v)) continue;
+
+                typename Metric::Cost arrival = ws.dist[u] + metric(u, i, v, ws.dist[u]);
+                if (arrival < ws.distance(v)) {
+                    ws.relax(v, arrival, u, i);
+                }
+            }
+        }
+        return u;
+    }
+
+    // Route from src to dest searched with metric. Its cost is measured with
+    // report instead, so search-only penalties stay out of it.
+    template <typename Metric, typename Closure, typename Report>
+    static bool findRoute(const Graph& graph, const Metric& metric, const Closure& closure, const Report& report,
+        int src, int dest, Route& route) {
+        SearchWorkspace<typename Metric::Cost>& ws = searchWorkspace<typename Metric::Cost>();
+        if (runSearch(graph, metric, closure, StopAtTarget(dest), src, ws) != dest) {
+            return false;
+        }
+
+        // Walk back from the destination to count the hops, then fill the
+        // route from the end so no reversal is needed
+        route.nodeCount = 0;
+        for (int at = dest; at != -1; at = ws.prev[at]) {
+            route.nodeCount++;
+        }
+        int index = route.nodeCount - 1;
+        route.edges[index] = -1; // No road out of the destination
+        for (int at = dest; at != -1; at = ws.prev[at], --index) {
+            route.nodes[index] = at;
+            if (index > 0) {
+                route.edges[index - 1] = ws.prevEdge[at];
+            }
+        }
+
+        typename Report::Cost cost = 0;
+        for (int i = 0; i + 1 < route.nodeCount; ++i) {
+            cost += report(route.nodes[i], route.edges[i], route.nodes[i + 1], cost);
+        }
+        route.cost = (int)cost;
+        return true;
+    }
+
+    template <typename Metric, typename Closure>
+    static bool findRoute(const Graph& graph, const Metric& metric, const Closure& closure, int src, int dest, Route& route) {
+        return findRoute(graph, metric, closure, metric, src, dest, route);
+    }
+
+    // Method to load traffic signals data from file
+    void loadTrafficSignalsFromFile(const string& filePath) {
+        ifstream file(filePath);
+        if (!file.is_open()) {
+            cout << "Error: Cannot open file: " << filePath << endl;
+            return;
+        }
+        int count = 0;
+        string line;
+        getline(file, line); // Skip the header
+        while (getline(file, line)) {
+            stringstream ss(line);
+            char intersection;
+            int greenTime;
+            char comma;
+            if (ss >> intersection >> comma >> greenTime) {
+                int index = intersection - BASE_CHAR; // Convert char to index (A -> 0, B -> 1, etc.)
+                signals[index].greenTime = greenTime;
+                signals[index].isGreen = true; // The new green phase starts now
+                signals[index].phaseStart = simulationTick * SIGNAL_SECONDS_PER_TICK;
+            }
+        }
+        file.close();
+    }
+
+    int partitionOf[MAX_NODES]; // Partition owning each intersection, -1 if it has no roads
+
+    // Number of roads from node to intersections in partition part
+    int linksToPartition(int node, int part) {
+        int links = 0;
+        for (int i = 0; i < graph.getEdges(node).getSize(); ++i) {
+            if (partitionOf[graph.getEdges(node)[i].destination] == part) links++;
+        }
+        return links;
+    }
+
+    int countEdgeCut() {
+        int cut = 0;
+        for (int u = 0; u < MAX_NODES; ++u) {
+            for (int i = 0; i < graph.getEdges(u).getSize(); ++i) {
+                int v = graph.getEdges(u)[i].destination;
+                if (partitionOf[u] != partitionOf[v]) cut++;
+            }
+        }
+        return cut;
+    }
+
+    // Splits the intersections into balanced parts with few roads between them.
+    // Each part is grown greedily from a peripheral seed, always taking the
+    // node with most roads into the part, then boundary nodes are moved to a
+    // neighbouring part while that lowers the cut and keeps the balance.
+    // Returns the number of directed roads crossing between parts.
+    int partitionGraph(int parts) {
+        int activeNodes = 0;
+        for (int i = 0; i < MAX_NODES; ++i) {
+            partitionOf[i] = -1;
+            if (graph.getEdges(i).getSize() > 0) activeNodes++;
+        }
+        const int UNASSIGNED = -2;
+        for (int i = 0; i < MAX_NODES; ++i) {
+            if (graph.getEdges(i).getSize() > 0) partitionOf[i] = UNASSIGNED;
+        }
+        if (parts > activeNodes) parts = activeNodes;
+
+        int size[MAX_SHARDS];
+        initializeArray(size, MAX_SHARDS, 0);
+        int assigned = 0;
+        for (int p = 0; p < parts; ++p) {
+            int target = (activeNodes - assigned) / (parts - p);
+            while (size[p] < target) {
+                // Prefer nodes tied to this part; start from the least connected node
+                int best = -1, bestLinks = -1;
+                for (int i = 0; i < MAX_NODES; ++i) {
+                    if (partitionOf[i] != UNASSIGNED) continue;
+                    int links = size[p] == 0 ? MAX_NODES - graph.getEdges(i).getSize() : linksToPartition(i, p);
+                    if (links > bestLinks) {
+                        best = i;
+                        bestLinks = links;
+                    }
+                }
+                partitionOf[best] = p;
+                size[p]++;
+                assigned++;
+            }
+        }
+
+        int maxSize = (activeNodes * PARTITION_IMBALANCE_PERCENT + parts * 100 - 1) / (parts * 100);
+        bool improved = true;
+        for (int pass = 0; pass < 10 && improved; ++pass) {
+            improved = false;
+            for (int u = 0; u < MAX_NODES; ++u) {
+                int own = partitionOf[u];
+                if (own < 0 || size[own] <= 1) continue;
+                int ownLinks = linksToPartition(u, own);
+                for (int q = 0; q < parts; ++q) {
+                    if (q == own || size[q] >= maxSize) continue;
+                    if (linksToPartition(u, q) > ownLinks) {
+                        partitionOf[u] = q;
+                        size[own]--;
+                        size[q]++;
+                        improved = true;
+                        break;
+                    }
+                }
+            }
+        }
+        return countEdgeCut();
+    }
+
+    void displayPartitions(int parts) {
+        for (int p = 0; p < parts; ++p) {
+            cout << "Partition " << p << ":";
+            for (int i = 0; i < MAX_NODES; ++i) {
+                if (partitionOf[i] == p) cout << " " << char(BASE_CHAR + i);
+            }
+            cout << "\n";
+        }
+    }
+
+#ifdef SHARDING_SUPPORTED
+    // A vehicle handed from one shard to another; fixed size so batches can be
+    // sent as raw bytes
+    struct CrossingRecord {
+        char id[16];
+        int currentNode;
+        int destinationNode;
+    };
+
+    struct ShardSummary {
+        int vehicles;
+        int arrived;
+        int crossingsOut;
+        int crossingsIn;
+    };
+
+    bool writeAll(int fd, const void* data, size_t length) {
+        const char* bytes = static_cast<const char*>(data);
+        while (length > 0) {
+            ssize_t written = write(fd, bytes, length);
+            if (written <= 0) return false;
+            bytes += written;
+            length -= written;
+        }
+        return true;
+    }
+
+    bool readAll(int fd, void* data, size_t length) {
+        char* bytes = static_cast<char*>(data);
+        while (length > 0) {
+            ssize_t got = read(fd, bytes, length);
+            if (got <= 0) return false;
+            bytes += got;
+            length -= got;
+        }
+        return true;
+    }
+
+    bool sendBatch(int fd, const CrossingRecord* batch, int count) {
+        return writeAll(fd, &count, sizeof(count)) &&
+            writeAll(fd, batch, sizeof(CrossingRecord) * count);
+    }
+
+    bool receiveBatch(int fd, CrossingRecord* batch, int& count) {
+        return readAll(fd, &count, sizeof(count)) && count >= 0 && count <= 150 &&
+            readAll(fd, batch, sizeof(CrossingRecord) * count);
+    }
+
+    // Body of one shard process. The shard keeps only the vehicles on its own
+    // intersections, runs their signals and counters, and once per tick sends
+    // the vehicles that left its partition to the coordinator and receives the
+    // ones that entered it.
+    void runShard(int shard, int fd, int ticks) {
+        int owned = 0;
+        for (int i = 0; i < vehicleCount; ++i) {
+            if (partitionOf[vehicles[i].currentNode] == shard) {
+                vehicles[owned++] = vehicles[i];
+            }
+        }
+        vehicleCount = owned;
+        initializeArray(vehicleCounts, MAX_NODES, 0);
+        for (int i = 0; i < vehicleCount; ++i) {
+            vehicleCounts[vehicles[i].currentNode]++;
+        }
+
+        static CrossingRecord outgoing[150], incoming[150];
+        ShardSummary summary = { 0, 0, 0, 0 };
+
+        bool greenDuringTick[MAX_NODES];
+        for (int tick = 0; tick < ticks; ++tick) {
+            edgeCosts.refresh(graph, vehicleCounts);
+            int tickStart = (simulationTick + tick) * SIGNAL_SECONDS_PER_TICK;
+            for (int n = 0; n < MAX_NODES; ++n) {
+                greenDuringTick[n] = partitionOf[n] == shard &&
+                    signals[n].advance(tickStart, tickStart + SIGNAL_SECONDS_PER_TICK) > 0;
+            }
+
+            int outgoingCount = 0;
+            for (int i = 0; i < vehicleCount; ++i) {
+                Vehicle& vehicle = vehicles[i];
+                if (vehicle.currentNode == vehicle.destinationNode || !greenDuringTick[vehicle.currentNode]) continue;
+
+                Route route;
+                if (!computeRoute(vehicle.currentNode, vehicle.destinationNode, true, route)) continue;
+                int nextNode = route.nodes[1];
+                vehicleCounts[vehicle.currentNode]--;
+                vehicle.currentNode = nextNode;
+                if (nextNode == vehicle.destinationNode) summary.arrived++;
+
+                if (partitionOf[nextNode] == shard) {
+                    vehicleCounts[nextNode]++;
+                    continue;
+                }
+
+                // Hand the vehicle over and drop it from this shard
+                CrossingRecord& record = outgoing[outgoingCount++];
+                vehicle.id.copy(record.id, sizeof(record.id) - 1);
+                record.id[min(vehicle.id.size(), sizeof(record.id) - 1)] = '\0';
+                record.currentNode = vehicle.currentNode;
+                record.destinationNode = vehicle.destinationNode;
+                vehicles[i--] = vehicles[--vehicleCount];
+            }
+
+            int incomingCount = 0;
+            if (!sendBatch(fd, outgoing, outgoingCount) || !receiveBatch(fd, incoming, incomingCount)) {
+                cout << "Shard " << shard << ": lost connection to coordinator.\n";
+                return;
+            }
+            summary.crossingsOut += outgoingCount;
+            summary.crossingsIn += incomingCount;
+            for (int i = 0; i < incomingCount && vehicleCount < 150; ++i) {
+                vehicles[vehicleCount++] = { incoming[i].id, incoming[i].currentNode, incoming[i].destinationNode };
+                vehicleCounts[incoming[i].currentNode]++;
+            }
+        }
+
+        summary.vehicles = vehicleCount;
+        writeAll(fd, &summary, sizeof(summary));
+    }
+
+    // Partitions the network and runs each partition in its own process. The
+    // parent acts as coordinator, routing the batched boundary crossings of
+    // every tick to the shards that own the destination intersections.
+    void runShardedSimulation(int shardCount, int ticks) {
+        if (shardCount < 1 || shardCount > MAX_SHARDS) {
+            cout << "Number of shards must be between 1 and " << MAX_SHARDS << ".\n";
+            return;
+        }
+        int activeNodes = 0;
+        for (int i = 0; i < MAX_NODES; ++i) {
+            if (graph.getEdges(i).getSize() > 0) activeNodes++;
+        }
+        if (activeNodes == 0) {
+            cout << "The road network is empty.\n";
+            return;
+        }
+        if (shardCount > activeNodes) {
+            cout << "Only " << activeNodes << " intersections have roads; using " << activeNodes << " shards.\n";
+            shardCount = activeNodes;
+        }
+        int cut = partitionGraph(shardCount);
+
+        // Every vehicle must belong to a shard and fit in a crossing record
+        bool canShard = true;
+        for (int i = 0; i < vehicleCount; ++i) {
+            if (partitionOf[vehicles[i].currentNode] < 0) {
+                cout << "Error: Vehicle " << vehicles[i].id << " is at "
+                    << char(BASE_CHAR + vehicles[i].currentNode) << ", which has no roads.\n";
+                canShard = false;
+            }
+            if (vehicles[i].id.size() >= sizeof(CrossingRecord::id)) {
+                cout << "Error: Vehicle ID " << vehicles[i].id << " is longer than "
+                    << sizeof(CrossingRecord::id) - 1 << " characters.\n";
+                canShard = false;
+            }
+        }
+        if (!canShard) {
+            cout << "Sharded simulation not started.\n";
+            return;
+        }
+        displayPartitions(shardCount);
+        cout << "Edge cut: " << cut << " directed roads\n";
+
+        int fds[MAX_SHARDS];
+        pid_t pids[MAX_SHARDS];
+        cout.flush();
+        for (int s = 0; s < shardCount; ++s) {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+                cout << "Error: Cannot create socket pair for shard " << s << ".\n";
+                return;
+            }
+            pids[s] = fork();
+            if (pids[s] == 0) {
+                close(pair[0]);
+                for (int other = 0; other < s; ++other) close(fds[other]);
+                runShard(s, pair[1], ticks);
+                close(pair[1]);
+                cout.flush();
+                _exit(0);
+            }
+            close(pair[1]);
+            fds[s] = pair[0];
+        }
+
+        static CrossingRecord batches[MAX_SHARDS][150], forward[MAX_SHARDS][150];
+        int batchCounts[MAX_SHARDS], forwardCounts[MAX_SHARDS];
+        bool ok = true;
+        for (int tick = 0; tick < ticks && ok; ++tick) {
+            initializeArray(forwardCounts, MAX_SHARDS, 0);
+            for (int s = 0; s < shardCount && ok; ++s) {
+                ok = receiveBatch(fds[s], batches[s], batchCounts[s]);
+                for (int i = 0; ok && i < batchCounts[s]; ++i) {
+                    int owner = partitionOf[batches[s][i].currentNode];
+                    if (owner >= 0 && forwardCounts[owner] < 150) {
+                        forward[owner][forwardCounts[owner]++] = batches[s][i];
+                    }
+                }
+            }
+            for (int s = 0; s < shardCount && ok; ++s) {
+                ok = sendBatch(fds[s], forward[s], forwardCounts[s]);
+            }
+        }
+
+        for (int s = 0; s < shardCount; ++s) {
+            ShardSummary summary;
+            if (ok && readAll(fds[s], &summary, sizeof(summary))) {
+                cout << "Shard " << s << ": " << summary.vehicles << " vehicles, "
+                    << summary.arrived << " arrivals, "
+                    << summary.crossingsOut << " sent, " << summary.crossingsIn << " received\n";
+            }
+            close(fds[s]);
+            waitpid(pids[s], nullptr, 0);
+        }
+        if (!ok) {
+            cout << "Error: A shard stopped responding.\n";
+        }
+    }
+#endif
+
+    template <typename T>
+    void writeBinary(ofstream& file, const T& value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    bool readBinary(ifstream& file, T& value) {
+        return bool(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    static bool isNodeIndex(int node) {
+        return node >= 0 && node < MAX_NODES;
+    }
+
+    // Writes everything the simulation needs to continue exactly where it is:
+    // vehicles, counters, signals with their random streams, closures and the
+    // current road network (closures remove roads from it).
+    bool saveCheckpoint(const string& filePath) {
+        ofstream file(filePath, ios::binary);
+        if (!file.is_open()) {
+            cout << "Error: Cannot open file: " << filePath << endl;
+            return false;
+        }
+
+        file.write("TMSCKPT", 8);
+        writeBinary(file, CHECKPOINT_VERSION);
+        writeBinary(file, simulationSeed);
+        writeBinary(file, simulationTick);
+
+        writeBinary(file, vehicleCount);
+        for (int i = 0; i < vehicleCount; ++i) {
+            int idLength = (int)vehicles[i].id.size();
+            writeBinary(file, idLength);
+            file.write(vehicles[i].id.data(), idLength);
+            writeBinary(file, vehicles[i].currentNode);
+            writeBinary(file, vehicles[i].destinationNode);
+            writeBinary(file, vehicles[i].roadTo);
+            writeBinary(file, vehicles[i].enteredTick);
+            const Route& plan = vehicles[i].plannedRoute;
+            writeBinary(file, plan.nodeCount);
+            file.write(reinterpret_cast<const char*>(plan.nodes), sizeof(int) * plan.nodeCount);
+            file.write(reinterpret_cast<const char*>(plan.edges), sizeof(int) * plan.nodeCount);
+            writeBinary(file, plan.cost);
+        }
+        file.write(reinterpret_cast<const char*>(vehicleCounts), sizeof(vehicleCounts));
+
+        for (int i = 0; i < MAX_NODES; ++i) {
+            writeBinary(file, signals[i].greenTime);
+            writeBinary(file, signals[i].isGreen);
+            writeBinary(file, signals[i].phaseStart);
+            writeBinary(file, signals[i].rng.state);
+        }
+
+        writeBinary(file, blockedCount);
+        file.write(reinterpret_cast<const char*>(blockedRoads), sizeof(BlockedRoad) * blockedCount);
+
+        for (int i = 0; i < MAX_NODES; ++i) {
+            const DynamicArray& edges = graph.getEdges(i);
+            writeBinary(file, edges.size);
+            file.write(reinterpret_cast<const char*>(edges.edges), sizeof(Edge) * edges.size);
+        }
+
+        for (int u = 0; u < MAX_NODES; ++u) {
+            for (int v = 0; v < MAX_NODES; ++v) {
+                const Queue& queue = roadQueues[u][v];
+                writeBinary(file, queue.capacity);
+                writeBinary(file, queue.size);
+                for (int i = 0; i < queue.size; ++i) {
+                    writeBinary(file, queue.at(i));
+                }
+            }
+        }
+
+        if (!file) {
+            cout << "Error: Failed writing checkpoint to " << filePath << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Reads a checkpoint into a scratch copy first so a damaged file leaves the
+    // running simulation untouched
+    bool loadCheckpoint(const string& filePath) {
+        ifstream file(filePath, ios::binary);
+        if (!file.is_open()) {
+            cout << "Error: Cannot open file: " << filePath << endl;
+            return false;
+        }
+
+        char magic[8];
+        unsigned int version = 0;
+        if (!file.read(magic, 8) || string(magic, 7) != "TMSCKPT" ||
+            !readBinary(file, version) || version != CHECKPOINT_VERSION) {
+            cout << "Error: " << filePath << " is not a supported checkpoint.\n";
+            return false;
+        }
+
+        TrafficManagementSystem* restored = new TrafficManagementSystem(*this);
+        bool ok = readBinary(file, restored->simulationSeed) && readBinary(file, restored->simulationTick) &&
+            readBinary(file, restored->vehicleCount) && restored->vehicleCount >= 0 && restored->vehicleCount <= 150;
+
+        for (int i = 0; ok && i < restored->vehicleCount; ++i) {
+            Vehicle& vehicle = restored->vehicles[i];
+            int idLength = 0;
+            ok = readBinary(file, idLength) && idLength >= 0 && idLength < 256;
+            if (!ok) break;
+            vehicle.id.assign(idLength, ' ');
+            ok = file.read(&vehicle.id[0], idLength) &&
+                readBinary(file, vehicle.currentNode) && readBinary(file, vehicle.destinationNode) &&
+                readBinary(file, vehicle.roadTo) && readBinary(file, vehicle.enteredTick) &&
+                isNodeIndex(vehicle.currentNode) && isNodeIndex(vehicle.destinationNode) &&
+                (vehicle.roadTo == -1 || isNodeIndex(vehicle.roadTo));
+
+            Route& plan = vehicle.plannedRoute;
+            ok = ok && readBinary(file, plan.nodeCount) && plan.nodeCount >= 0 && plan.nodeCount <= MAX_NODES &&
+                file.read(reinterpret_cast<char*>(plan.nodes), sizeof(int) * plan.nodeCount) &&
+                file.read(reinterpret_cast<char*>(plan.edges), sizeof(int) * plan.nodeCount) &&
+                readBinary(file, plan.cost);
+            for (int n = 0; ok && n < plan.nodeCount; ++n) {
+                ok = isNodeIndex(plan.nodes[n]);
+            }
+        }
+        ok = ok && file.read(reinterpret_cast<char*>(restored->vehicleCounts), sizeof(restored->vehicleCounts));
+
+        for (int i = 0; ok && i < MAX_NODES; ++i) {
+            ok = readBinary(file, restored->signals[i].greenTime) && readBinary(file, restored->signals[i].isGreen) &&
+                readBinary(file, restored->signals[i].phaseStart) &&
+                readBinary(file, restored->signals[i].rng.state);
+        }
+
+        ok = ok && readBinary(file, restored->blockedCount) && restored->blockedCount >= 0 && restored->blockedCount <= 100 &&
+            file.read(reinterpret_cast<char*>(restored->blockedRoads), sizeof(BlockedRoad) * restored->blockedCount);
+        for (int i = 0; ok && i < restored->blockedCount; ++i) {
+            ok = isNodeIndex(restored->blockedRoads[i].from - BASE_CHAR) && isNodeIndex(restored->blockedRoads[i].to - BASE_CHAR);
+        }
+
+        for (int i = 0; ok && i < MAX_NODES; ++i) {
+            DynamicArray& edges = restored->graph.adjacencyList[i];
+            ok = readBinary(file, edges.size) && edges.size >= 0 && edges.size <= MAX_NODES &&
+                file.read(reinterpret_cast<char*>(edges.edges), sizeof(Edge) * edges.size);
+            for (int e = 0; ok && e < edges.size; ++e) {
+                ok = isNodeIndex(edges.edges[e].destination);
+            }
+        }
+
+        // Queues are sized from road length, so a sane capacity is bounded by
+        // the road's weight; a closed road keeps its old capacity, so it is
+        // bounded by the heaviest road instead and must hold no vehicles
+        long long heaviestRoad = 1;
+        for (int i = 0; ok && i < MAX_NODES; ++i) {
+            const DynamicArray& edges = restored->graph.adjacencyList[i];
+            for (int e = 0; e < edges.size; ++e) {
+                heaviestRoad = max<long long>(heaviestRoad, edges.edges[e].weight);
+            }
+        }
+        bool queued[150] = {};
+        int queuedCount = 0;
+        for (int u = 0; ok && u < MAX_NODES; ++u) {
+            for (int v = 0; ok && v < MAX_NODES; ++v) {
+                long long weight = -1;
+                const DynamicArray& edges = restored->graph.adjacencyList[u];
+                for (int e = 0; e < edges.size; ++e) {
+                    if (edges.edges[e].destination == v) weight = max<long long>(1, edges.edges[e].weight);
+                }
+                long long maxCapacity = (long long)MAX_NODES * (weight == -1 ? heaviestRoad : weight) * ROAD_QUEUE_VEHICLES_PER_UNIT;
+
+                int capacity = 0, size = 0;
+                ok = readBinary(file, capacity) && readBinary(file, size) &&
+                    capacity >= 0 && capacity <= maxCapacity && size >= 0 && size <= capacity &&
+                    (weight != -1 || size == 0);
+                if (!ok) break;
+                Queue& queue = restored->roadQueues[u][v];
+                if (queue.capacity != capacity) {
+                    queue = Queue(capacity);
+                }
+                queue.front = queue.size = 0;
+                queue.rear = -1;
+                for (int i = 0; ok && i < size; ++i) {
+                    int index = 0;
+                    // Each vehicle on the road must be recorded as travelling u -> v, and only once
+                    ok = readBinary(file, index) && index >= 0 && index < restored->vehicleCount && !queued[index] &&
+                        restored->vehicles[index].currentNode == u && restored->vehicles[index].roadTo == v;
+                    if (!ok) break;
+                    queued[index] = true;
+                    queuedCount++;
+                    queue.enqueue(index);
+                }
+            }
+        }
+        // ... and every vehicle on a road must be in that road's queue
+        for (int i = 0; ok && i < restored->vehicleCount; ++i) {
+            if (restored->vehicles[i].roadTo != -1) queuedCount--;
+        }
+        ok = ok && queuedCount == 0;
+
+        if (ok) {
+            // Copy field by field: the query server may be reading the live snapshot pointer
+            simulationSeed = restored->simulationSeed;
+            simulationTick = restored->simulationTick;
+            vehicleCount = restored->vehicleCount;
+            for (int i = 0; i < vehicleCount; ++i) {
+                vehicles[i] = restored->vehicles[i];
+            }
+            for (int i = 0; i < MAX_NODES; ++i) {
+                vehicleCounts[i] = restored->vehicleCounts[i];
+                signals[i] = restored->signals[i];
+            }
+            blockedCount = restored->blockedCount;
+            for (int i = 0; i < blockedCount; ++i) {
+                blockedRoads[i] = restored->blockedRoads[i];
+            }
+            graph = restored->graph;
+            for (int u = 0; u < MAX_NODES; ++u) {
+                for (int v = 0; v < MAX_NODES; ++v) {
+                    roadQueues[u][v] = restored->roadQueues[u][v];
+                }
+            }
+            publishSnapshot();
+        }
+        else {
+            cout << "Error: Checkpoint " << filePath << " is truncated or damaged.\n";
+        }
+        delete restored;
+        return ok;
+    }
+
+    // Streams per-tick vehicle positions, road occupancy and signal states to
+    // a columnar binary file.
+    //
+    // Layout: the magic "TMSTRAJ2", then a sequence of chunks that each start
+    // with a one-byte tag:
+    //   'D' dictionary: count, then (length, bytes) for each new vehicle ID
+    //   'R' row group: three tables (vehicles, roads, signals), each a row
+    //       count followed by its column chunks
+    //   'E' footer: total rows, the full dictionary (count, then (length,
+    //       bytes) per ID), then the row group index: count, then (offset of
+    //       its 'R' tag, first tick, last tick) per group
+    // The file ends with the footer's offset as 8 little-endian bytes and the
+    // magic again, so a reader can seek to the footer, pick the row groups
+    // covering the ticks it wants and read only those.
+    // A column chunk is (type, encoding, byte length, bytes). Tick columns are
+    // delta encoded as zigzag varints, vehicle IDs are dictionary indices and
+    // node columns are plain bytes. A vehicle's road column holds the node it
+    // is queued towards, or 255 while it waits at an intersection. All counts,
+    // lengths, offsets and ticks in chunks are varints.
+    //
+    // Recording only appends to the active row group. Once it holds enough
+    // ticks it is swapped with the idle one and a background thread writes it
+    // out, so the simulation only waits if the writer falls a full group behind.
+    struct TrajectoryExporter {
+        enum ColumnType { UINT8_COLUMN = 1, INT32_COLUMN = 2 };
+        enum ColumnEncoding { PLAIN = 1, VARINT = 2, DELTA_VARINT = 3, DICTIONARY = 4 };
+
+        struct Column {
+            unsigned char type;
+            unsigned char encoding;
+            vector<unsigned char> bytes;
+            int lastValue; // Previous value, for delta encoding
+
+            Column(unsigned char columnType, unsigned char columnEncoding)
+                : type(columnType), encoding(columnEncoding), lastValue(0) {}
+
+            void clear() {
+                bytes.clear(); // Keeps capacity, so steady-state ticks do not allocate
+                lastValue = 0;
+            }
+
+            void putVarint(unsigned int value) {
+                while (value >= 0x80) {
+                    bytes.push_back((unsigned char)(value | 0x80));
+                    value >>= 7;
+                }
+                bytes.push_back((unsigned char)value);
+            }
+
+            void append(int value) {
+                if (encoding == PLAIN) {
+                    bytes.push_back((unsigned char)value);
+                }
+                else if (encoding == DELTA_VARINT) {
+                    int delta = value - lastValue;
+                    lastValue = value;
+                    putVarint(((unsigned int)delta << 1) ^ (unsigned int)(delta >> 31)); // zigzag
+                }
+                else {
+                    putVarint((unsigned int)value);
+                }
+            }
+        };
+
+        struct RowGroup {
+            Column vehicleTick, vehicleId, vehicleNode, vehicleRoad;
+            Column roadTick, roadFrom, roadTo, roadOccupancy;
+            Column signalTick, signalNode, signalGreen, signalTime;
+            vector<string> newIds; // Dictionary entries first used in this group
+            int vehicleRows, roadRows, signalRows, ticks;
+            int firstTick, lastTick;
+
+            RowGroup()
+                : vehicleTick(INT32_COLUMN, DELTA_VARINT), vehicleId(INT32_COLUMN, DICTIONARY), vehicleNode(UINT8_COLUMN, PLAIN),
+                vehicleRoad(UINT8_COLUMN, PLAIN),
+                roadTick(INT32_COLUMN, DELTA_VARINT), roadFrom(UINT8_COLUMN, PLAIN), roadTo(UINT8_COLUMN, PLAIN),
+                roadOccupancy(INT32_COLUMN, VARINT),
+                signalTick(INT32_COLUMN, DELTA_VARINT), signalNode(UINT8_COLUMN, PLAIN), signalGreen(UINT8_COLUMN, PLAIN),
+                signalTime(INT32_COLUMN, VARINT),
+                vehicleRows(0), roadRows(0), signalRows(0), ticks(0), firstTick(0), lastTick(0) {}
+
+            void clear() {
+                Column* columns[] = { &vehicleTick, &vehicleId, &vehicleNode, &vehicleRoad, &roadTick, &roadFrom, &roadTo,
+                    &roadOccupancy, &signalTick, &signalNode, &signalGreen, &signalTime };
+                for (Column* column : columns) column->clear();
+                newIds.clear();
+                vehicleRows = roadRows = signalRows = ticks = 0;
+            }
+        };
+
+        // Where a written row group starts and which ticks it covers
+        struct GroupIndexEntry {
+            unsigned long long offset;
+            int firstTick, lastTick;
+        };
+
+        ofstream file;
+        RowGroup groups[2];
+        RowGroup* active;
+        RowGroup* flushing;   // Group handed to the writer, nullptr when it is idle
+        unordered_map<string, int> dictionary; // Vehicle ID -> index
+        long long totalRows;
+        bool stopping;
+        bool failed; // Set once a write to the file fails
+        vector<GroupIndexEntry> groupIndex; // Only touched by the writer until it stops
+        mutex lock;
+        condition_variable changed;
+        thread writer;
+
+        TrajectoryExporter() : active(&groups[0]), flushing(nullptr), totalRows(0), stopping(false), failed(false) {}
+
+        bool open(const string& filePath) {
+            file.open(filePath, ios::binary);
+            if (!file.is_open()) {
+                return false;
+            }
+            file.write("TMSTRAJ2", 8);
+            writer = thread(&TrajectoryExporter::writerLoop, this);
+            return true;
+        }
+
+        int dictionaryIndex(const string& id) {
+            auto inserted = dictionary.emplace(id, (int)dictionary.size());
+            if (inserted.second) {
+                active->newIds.push_back(id);
+            }
+            return inserted.first->second;
+        }
+
+        void addVehicle(int tick, const string& id, int node, int roadTo) {
+            active->vehicleTick.append(tick);
+            active->vehicleId.append(dictionaryIndex(id));
+            active->vehicleNode.append(node);
+            active->vehicleRoad.append(roadTo == -1 ? 255 : roadTo);
+            active->vehicleRows++;
+        }
+
+        void addRoad(int tick, int from, int to, int occupancy) {
+            active->roadTick.append(tick);
+            active->roadFrom.append(from);
+            active->roadTo.append(to);
+            active->roadOccupancy.append(occupancy);
+            active->roadRows++;
+        }
+
+        void addSignal(int tick, int node, bool isGreen, int greenTime) {
+            active->signalTick.append(tick);
+            active->signalNode.append(node);
+            active->signalGreen.append(isGreen ? 1 : 0);
+            active->signalTime.append(greenTime);
+            active->signalRows++;
+        }
+
+        void endTick(int tick) {
+            if (active->ticks == 0) active->firstTick = tick;
+            active->lastTick = tick;
+            if (++active->ticks >= TRAJECTORY_TICKS_PER_ROW_GROUP) {
+                handOff();
+            }
+        }
+
+        // Gives the active group to the writer and continues in the other one
+        void handOff() {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [this] { return flushing == nullptr; });
+            flushing = active;
+            active = (active == &groups[0]) ? &groups[1] : &groups[0];
+            changed.notify_all();
+        }
+
+        // Returns false if any part of the file could not be written
+        bool close() {
+            if (!writer.joinable()) return !failed;
+            if (active->ticks > 0) handOff();
+            {
+                lock_guard<mutex> guard(lock);
+                stopping = true;
+            }
+            changed.notify_all();
+            writer.join();
+            writeFooter();
+            file.close();
+            if (!file) failed = true;
+            return !failed;
+        }
+
+        void putVarint(unsigned long long value) {
+            while (value >= 0x80) {
+                file.put((char)(value | 0x80));
+                value >>= 7;
+            }
+            file.put((char)value);
+        }
+
+        void writeFooter() {
+            unsigned long long footerOffset = (unsigned long long)file.tellp();
+            file.put('E');
+            putVarint(totalRows);
+            vector<const string*> ids(dictionary.size());
+            for (const auto& entry : dictionary) {
+                ids[entry.second] = &entry.first;
+            }
+            putVarint(ids.size());
+            for (const string* id : ids) {
+                putVarint(id->size());
+                file.write(id->data(), id->size());
+            }
+            putVarint(groupIndex.size());
+            for (const GroupIndexEntry& entry : groupIndex) {
+                putVarint(entry.offset);
+                putVarint((unsigned int)entry.firstTick);
+                putVarint((unsigned int)entry.lastTick);
+            }
+            for (int i = 0; i < 8; ++i) {
+                file.put((char)(footerOffset >> (8 * i)));
+            }
+            file.write("TMSTRAJ2", 8);
+        }
+
+        void writeColumn(const Column& column) {
+            file.put((char)column.type);
+            file.put((char)column.encoding);
+            putVarint(column.bytes.size());
+            file.write(reinterpret_cast<const char*>(column.bytes.data()), column.bytes.size());
+        }
+
+        void writeGroup(const RowGroup& group) {
+            if (!group.newIds.empty()) {
+                file.put('D');
+                putVarint(group.newIds.size());
+                for (const string& id : group.newIds) {
+                    putVarint(id.size());
+                    file.write(id.data(), id.size());
+                }
+            }
+            groupIndex.push_back({ (unsigned long long)file.tellp(), group.firstTick, group.lastTick });
+            file.put('R');
+            putVarint(group.vehicleRows);
+            writeColumn(group.vehicleTick);
+            writeColumn(group.vehicleId);
+            writeColumn(group.vehicleNode);
+            writeColumn(group.vehicleRoad);
+            putVarint(group.roadRows);
+            writeColumn(group.roadTick);
+            writeColumn(group.roadFrom);
+            writeColumn(group.roadTo);
+            writeColumn(group.roadOccupancy);
+            putVarint(group.signalRows);
+            writeColumn(group.signalTick);
+            writeColumn(group.signalNode);
+            writeColumn(group.signalGreen);
+            writeColumn(group.signalTime);
+            file.flush();
+        }
+
+        void writerLoop() {
+            unique_lock<mutex> guard(lock);
+            while (true) {
+                changed.wait(guard, [this] { return flushing != nullptr || stopping; });
+                if (flushing == nullptr) return;
+
+                RowGroup* group = flushing;
+                guard.unlock();
+                writeGroup(*group); // The simulation keeps filling the other group meanwhile
+                bool written = bool(file);
+                if (written) totalRows += group->vehicleRows + group->roadRows + group->signalRows;
+                group->clear();
+                guard.lock();
+                if (!written) failed = true;
+                flushing = nullptr;
+                changed.notify_all();
+            }
+        }
+    };
+
+    TrajectoryExporter* exporter = nullptr; // Set while trajectories are being exported
+
+    void recordTrajectoryTick() {
+        if (exporter == nullptr) return;
+        for (int i = 0; i < vehicleCount; ++i) {
+            exporter->addVehicle(simulationTick, vehicles[i].id, vehicles[i].currentNode, vehicles[i].roadTo);
+        }
+        for (int i = 0; i < MAX_NODES; ++i) {
+            for (int j = 0; j < graph.getEdges(i).getSize(); ++j) {
+                int dest = graph.getEdges(i)[j].destination;
+                exporter->addRoad(simulationTick, i, dest, roadQueues[i][dest].getSize());
+            }
+            exporter->addSignal(simulationTick, i, signals[i].isGreen, signals[i].greenTime);
+        }
+        exporter->endTick(simulationTick);
+    }
+
+    void startTrajectoryExport(const string& filePath) {
+        if (exporter != nullptr) return;
+        exporter = new TrajectoryExporter();
+        if (!exporter->open(filePath)) {
+            cout << "Error: Cannot open file: " << filePath << endl;
+            delete exporter;
+            exporter = nullptr;
+            return;
+        }
+        cout << "Exporting trajectories to " << filePath << ".\n";
+    }
+
+    void stopTrajectoryExport() {
+        if (exporter == nullptr) return;
+        if (exporter->close()) {
+            cout << "Trajectory export stopped after " << exporter->totalRows << " rows.\n";
+        }
+        else {
+            cout << "Error: Failed writing trajectories; only the first " << exporter->totalRows << " rows were saved.\n";
+        }
+        delete exporter;
+        exporter = nullptr;
+    }
+
+    // Immutable copy of everything a route query reads. Readers take the
+    // current one with an atomic load and keep it alive while they use it;
+    // writers build a new one and swap it in, so neither waits on the other.
+    struct GraphSnapshot {
+        Graph graph;
+        EdgeCostTable costs;
+        unsigned long long version;
+    };
+
+    shared_ptr<const GraphSnapshot> snapshot;
+    unsigned long long snapshotVersion = 0;
+
+    // Also the per-tick cost stage: every tick, road change and restore ends here
+    void publishSnapshot() {
+        edgeCosts.refresh(graph, vehicleCounts);
+        shared_ptr<GraphSnapshot> next = make_shared<GraphSnapshot>();
+        next->graph = graph;
+        next->costs = edgeCosts;
+        next->version = ++snapshotVersion;
+        atomic_store(&snapshot, shared_ptr<const GraphSnapshot>(next));
+    }
+
+#ifdef QUERY_SERVER_SUPPORTED
+    // Answers route and ETA requests from other processes over a Unix domain
+    // socket. One thread polls the listening socket and every open connection;
+    // when a connection has complete request lines it hands them to a fixed
+    // pool of workers, so an idle client never holds a thread. A connection is
+    // left out of the poll while a worker answers it, which keeps its replies
+    // in order. Each request is answered from the snapshot current when it
+    // arrives. Protocol, one request per line:
+    //   ROUTE A F  ->  OK <time> A C E F
+    //   ETA A F    ->  OK <time>
+    // Anything else, or an unreachable destination, gets "ERR <reason>".
+    struct RouteQueryServer {
+        struct Client {
+            int fd;       // -1 when the slot is free
+            bool busy;    // A worker is answering its requests
+            bool broken;  // A reply could not be sent; close once the worker is done
+            char buffer[512];
+            int used;     // Bytes of an unfinished line, only touched by the poller
+        };
+
+        struct Job {
+            int client;
+            int fd;
+            string lines; // One or more complete requests, each ending in '\n'
+            chrono::steady_clock::time_point arrivedAt; // When the poller read them
+        };
+
+        TrafficManagementSystem* system;
+        string socketPath;
+        int listenFd;
+        int wakeFds[2]; // Pipe that interrupts the poll when a client is released or on stop
+        atomic<bool> stopping;
+        thread poller;
+        thread workers[ROUTE_SERVER_THREADS];
+        Client clients[ROUTE_SERVER_MAX_CLIENTS];
+
+        mutex pendingLock;
+        condition_variable pendingChanged;
+        Job pending[ROUTE_SERVER_MAX_CLIENTS]; // At most one job per client, so this never fills
+        int pendingHead, pendingCount;
+
+        atomic<long long> requests;
+        chrono::steady_clock::time_point startedAt;
+        mutex latencyLock;
+        int latencies[ROUTE_SERVER_LATENCY_SAMPLES]; // Microseconds, ring buffer
+        long long latencyCount;
+
+        RouteQueryServer(TrafficManagementSystem* owner)
+            : system(owner), listenFd(-1), stopping(false), pendingHead(0), pendingCount(0),
+            requests(0), latencyCount(0) {
+            wakeFds[0] = wakeFds[1] = -1;
+            for (int i = 0; i < ROUTE_SERVER_MAX_CLIENTS; ++i) {
+                clients[i].fd = -1;
+            }
+        }
+
+        bool start(const string& path) {
+            socketPath = path;
+            if (pipe(wakeFds) != 0) return false;
+            fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
+            fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
+            listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listenFd < 0) {
+                closeWakePipe();
+                return false;
+            }
+
+            sockaddr_un address = {};
+            address.sun_family = AF_UNIX;
+            path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+            unlink(path.c_str());
+            if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+                listen(listenFd, 128) != 0) {
+                ::close(listenFd);
+                closeWakePipe();
+                return false;
+            }
+
+            startedAt = chrono::steady_clock::now();
+            for (int i = 0; i < ROUTE_SERVER_THREADS; ++i) {
+                workers[i] = thread(&RouteQueryServer::workerLoop, this);
+            }
+            poller = thread(&RouteQueryServer::pollLoop, this);
+            return true;
+        }
+
+        void stop() {
+            {
+                // Under the lock so a worker about to wait cannot miss the change
+                lock_guard<mutex> guard(pendingLock);
+                stopping = true;
+            }
+            pendingChanged.notify_all();
+            wake();
+            poller.join();
+            for (int i = 0; i < ROUTE_SERVER_THREADS; ++i) {
+                workers[i].join();
+            }
+            for (int i = 0; i < ROUTE_SERVER_MAX_CLIENTS; ++i) {
+                if (clients[i].fd >= 0) ::close(clients[i].fd);
+                clients[i].fd = -1;
+            }
+            ::close(listenFd);
+            closeWakePipe();
+            unlink(socketPath.c_str());
+        }
+
+        void closeWakePipe() {
+            ::close(wakeFds[0]);
+            ::close(wakeFds[1]);
+            wakeFds[0] = wakeFds[1] = -1;
+        }
+
+        void wake() {
+            char signalByte = 1;
+            if (write(wakeFds[1], &signalByte, 1) < 0) {
+                // Pipe already full: the poller is going to wake up anyway
+            }
+        }
+
+        void pollLoop() {
+            pollfd watched[ROUTE_SERVER_MAX_CLIENTS + 2];
+            int slotOf[ROUTE_SERVER_MAX_CLIENTS + 2];
+            while (!stopping) {
+                int count = 0;
+                watched[count++] = { wakeFds[0], POLLIN, 0 };
+                watched[count++] = { listenFd, POLLIN, 0 };
+                {
+                    lock_guard<mutex> guard(pendingLock);
+                    for (int i = 0; i < ROUTE_SERVER_MAX_CLIENTS; ++i) {
+                        Client& client = clients[i];
+                        if (client.fd < 0 || client.busy) continue;
+                        if (client.broken) {
+                            closeClient(i);
+                            continue;
+                        }
+                        slotOf[count] = i;
+                        watched[count++] = { client.fd, POLLIN, 0 };
+                    }
+                }
+
+                if (poll(watched, count, -1) <= 0) continue;
+                if (watched[0].revents != 0) {
+                    char drained[64];
+                    while (read(wakeFds[0], drained, sizeof(drained)) > 0) {}
+                }
+                if (watched[1].revents & POLLIN) {
+                    acceptClient();
+                }
+                for (int i = 2; i < count; ++i) {
+                    if (watched[i].revents != 0) readClient(slotOf[i]);
+                }
+            }
+        }
+
+        void acceptClient() {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) return;
+#ifdef SO_NOSIGPIPE
+            int on = 1;
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+            for (int i = 0; i < ROUTE_SERVER_MAX_CLIENTS; ++i) {
+                Client& client = clients[i];
+                if (client.fd >= 0) continue;
+                lock_guard<mutex> guard(pendingLock);
+                client.fd = fd;
+                client.busy = client.broken = false;
+                client.used = 0;
+                return;
+            }
+            ::close(fd); // Every slot is taken
+        }
+
+        void closeClient(int slot) {
+            ::close(clients[slot].fd);
+            clients[slot].fd = -1;
+        }
+
+        // Reads what the client has sent and queues every complete line for a
+        // worker; an unfinished line stays in the buffer for the next read
+        void readClient(int slot) {
+            Client& client = clients[slot];
+            chrono::steady_clock::time_point arrivedAt = chrono::steady_clock::now();
+            ssize_t got = read(client.fd, client.buffer + client.used, sizeof(client.buffer) - client.used);
+            if (got <= 0) {
+                closeClient(slot);
+                return;
+            }
+            client.used += (int)got;
+
+            int end = client.used;
+            while (end > 0 && client.buffer[end - 1] != '\n') end--;
+            if (end == 0) {
+                if (client.used == (int)sizeof(client.buffer)) closeClient(slot); // Line too long
+                return;
+            }
+
+            lock_guard<mutex> guard(pendingLock);
+            Job& job = pending[(pendingHead + pendingCount++) % ROUTE_SERVER_MAX_CLIENTS];
+            job.client = slot;
+            job.fd = client.fd;
+            job.lines.assign(client.buffer, end);
+            job.arrivedAt = arrivedAt;
+            client.used -= end;
+            for (int i = 0; i < client.used; ++i) {
+                client.buffer[i] = client.buffer[end + i];
+            }
+            client.busy = true;
+            pendingChanged.notify_one();
+        }
+
+        void workerLoop() {
+            while (true) {
+                Job job;
+                {
+                    unique_lock<mutex> guard(pendingLock);
+                    pendingChanged.wait(guard, [this] { return pendingCount > 0 || stopping; });
+                    if (stopping) return;
+                    job = move(pending[pendingHead]);
+                    pendingHead = (pendingHead + 1) % ROUTE_SERVER_MAX_CLIENTS;
+                    pendingCount--;
+                }
+
+                bool sent = true;
+                size_t lineStart = 0;
+                for (size_t i = 0; i < job.lines.size(); ++i) {
+                    if (job.lines[i] != '\n') continue;
+                    string reply = handleRequest(job.lines.substr(lineStart, i - lineStart));
+                    // A client hanging up must fail the send, not raise SIGPIPE in the simulation
+                    sent = sent && send(job.fd, reply.data(), reply.size(), MSG_NOSIGNAL) == (ssize_t)reply.size();
+                    recordLatency(job.arrivedAt); // Includes the wait for a worker and the send
+                    lineStart = i + 1;
+                }
+
+                {
+                    lock_guard<mutex> guard(pendingLock);
+                    clients[job.client].busy = false;
+                    clients[job.client].broken = !sent;
+                }
+                wake(); // Put the connection back into the poll
+            }
+        }
+
+        string handleRequest(const string& line) {
+            string reply;
+
+            stringstream ss(line);
+            string command;
+            char from = 0, to = 0;
+            ss >> command >> from >> to;
+            if ((command != "ROUTE" && command != "ETA") || from < BASE_CHAR || from >= BASE_CHAR + MAX_NODES ||
+                to < BASE_CHAR || to >= BASE_CHAR + MAX_NODES) {
+                reply = "ERR expected ROUTE <from> <to> or ETA <from> <to>\n";
+            }
+            else {
+                shared_ptr<const GraphSnapshot> current = atomic_load(&system->snapshot);
+                Route route;
+                if (!current || !computeRouteOn(current->graph, current->costs,
+                    from - BASE_CHAR, to - BASE_CHAR, true, route)) {
+                    reply = "ERR no path\n";
+                }
+                else {
+                    reply = "OK " + to_string(route.cost);
+                    if (command == "ROUTE") {
+                        for (int i = 0; i < route.nodeCount; ++i) {
+                            reply += ' ';
+                            reply += char(BASE_CHAR + route.nodes[i]);
+                        }
+                    }
+                    reply += '\n';
+                }
+            }
+            return reply;
+        }
+
+        // Time from the poller reading a request to its reply being sent
+        void recordLatency(chrono::steady_clock::time_point arrivedAt) {
+            int micros = (int)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - arrivedAt).count();
+            requests++;
+            lock_guard<mutex> guard(latencyLock);
+            latencies[latencyCount++ % ROUTE_SERVER_LATENCY_SAMPLES] = micros;
+        }
+
+        void printStatistics() {
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - startedAt).count();
+            static int sorted[ROUTE_SERVER_LATENCY_SAMPLES];
+            int samples;
+            {
+                lock_guard<mutex> guard(latencyLock);
+                samples = (int)min<long long>(latencyCount, ROUTE_SERVER_LATENCY_SAMPLES);
+                for (int i = 0; i < samples; ++i) sorted[i] = latencies[i];
+            }
+            cout << "Route server: " << requests << " requests in " << seconds << "s ("
+                << (seconds > 0 ? requests / seconds : 0) << " requests/s)\n";
+            if (samples == 0) return;
+            sort(sorted, sorted + samples);
+            cout << "Latency over last " << samples << " requests: p50 " << sorted[samples / 2]
+                << "us, p99 " << sorted[samples * 99 / 100]
+                << "us, p99.9 " << sorted[samples * 999 / 1000]
+                << "us, max " << sorted[samples - 1] << "us\n";
+        }
+    };
+
+    RouteQueryServer* routeServer = nullptr; // Set while the query server is running
+
+    void startRouteServer() {
+        if (routeServer != nullptr) return;
+        publishSnapshot();
+        routeServer = new RouteQueryServer(this);
+        if (!routeServer->start(ROUTE_SERVER_SOCKET)) {
+            cout << "Error: Cannot listen on " << ROUTE_SERVER_SOCKET << endl;
+            delete routeServer;
+            routeServer = nullptr;
+            return;
+        }
+        cout << "Route query server listening on " << ROUTE_SERVER_SOCKET << ".\n";
+    }
+
+    void stopRouteServer() {
+        if (routeServer == nullptr) return;
+        routeServer->stop();
+        routeServer->printStatistics();
+        delete routeServer;
+        routeServer = nullptr;
+        cout << "Route query server stopped.\n";
+    }
+#endif
+
+public:
+    TrafficManagementSystem() : blockedCount(0) {
+        initializeArray(vehicleCounts, MAX_NODES, 0);
+        seedRandomStreams(DEFAULT_SIMULATION_SEED);
+        edgeCosts.refresh(graph, vehicleCounts);
+    }
+
+    void addRoad(int src, int dest, int weight) {
+        graph.addEdge(src, dest, weight);
+        createRoadQueue(src, dest, weight);
+        publishSnapshot();
+    }
+
+    void removeRoad(int src, int dest) {
+        graph.removeEdge(src, dest);
+        graph.removeEdge(dest, src);  // Assuming bidirectional roads
+        emptyRoadQueue(src, dest);
+        emptyRoadQueue(dest, src);
+        publishSnapshot();
+    }
+
+    void loadRoadNetworkFromFile(const string& filePath) {
+        ifstream file(filePath);
+        if (!file.is_open()) {
+            cout << "Error: Cannot open file: " << filePath << endl;
+            return;
+        }
+        string line;
+        while (getline(file, line)) {
+            stringstream ss(line);
+            char src, dest;
+            int weight;
             char comma;
             if (ss >> src >> comma >> dest >> comma >> weight) {
                 addRoad(src - BASE_CHAR, dest - BASE_CHAR, weight);
@@ -614,60 +2640,32 @@ public:
         cout << "Emergency Vehicle is being routed...\n";
 
         // Call Dijkstra's Algorithm to find the shortest path
-        string path = findShortestPath(start, end);
-        cout << "Emergency Vehicle path: " << path << "\n";
+        Route route;
+        if (!findShortestPath(start, end, route)) {
+            cout << "No path found from " << startChar << " to " << endChar << ".\n";
+            return;
+        }
+        cout << "Emergency Vehicle path: ";
+        printRoute(route);
+        cout << "\n";
 
         // Simulate clearing traffic signals for the route
-        clearTrafficForEmergency(path);
+        clearTrafficForEmergency(route);
 
         // Restore normal traffic flow
         cout << "Normal traffic flow restored.\n";
     }
 
-    string findShortestPath(int start, int end) {
-        int dist[MAX_NODES];
-        int prev[MAX_NODES];
-        bool visited[MAX_NODES];
-
-        initializeArray(dist, MAX_NODES, 1000000000); // Initialize distances to infinity
-        initializeArray(prev, MAX_NODES, -1);        // Initialize previous node tracker
-        initializeBoolArray(visited, MAX_NODES, false);
-
-        dist[start] = 0;
-
-        for (int i = 0; i < MAX_NODES; ++i) {
-            int u = findMinDistance(dist, visited, MAX_NODES);
-            if (u == -1) break; // No more reachable nodes
-            visited[u] = true;
-
-            for (int j = 0; j < graph.getEdges(u).getSize(); ++j) {
-                Edge edge = graph.getEdges(u)[j];
-                int v = edge.destination;
-                int weight = edge.weight;
-
-                if (!visited[v] && dist[u] + weight < dist[v]) {
-                    dist[v] = dist[u] + weight;
-                    prev[v] = u;
-                }
-            }
-        }
-
-        // Construct the path from start to end
-        string path = "";
-        for (int at = end; at != -1; at = prev[at]) {
-            path = char(BASE_CHAR + at) + path;
-            if (at != start) path = " " + path;
-        }
-        return path;
+    bool findShortestPath(int start, int end, Route& route) {
+        return computeRoute(start, end, false, route);
     }
 
-    void clearTrafficForEmergency(const string& path) {
-        cout << "Clearing traffic signals along the path: " << path << "\n";
-        for (char c : path) {
-            if (c != ' ') {
-                int node = c - BASE_CHAR;
-                signals[node].isGreen = true; // Set all signals to green
-            }
+    void clearTrafficForEmergency(const Route& route) {
+        cout << "Clearing traffic signals along the path: ";
+        printRoute(route);
+        cout << "\n";
+        for (int i = 0; i < route.nodeCount; ++i) {
+            signals[route.nodes[i]].isGreen = true; // Set all signals to green
         }
     }
 
@@ -689,7 +2687,13 @@ public:
             cout << "6. Block a Road\n";
             cout << "7. Unblock a Road\n";
             cout << "8. Handle Emergency Vehicle Routing\n";
-            cout << "9. Exit Simulation\n";
+            cout << "9. Run Sharded Simulation\n";
+            cout << "10. Save Checkpoint\n";
+            cout << "11. Restore Checkpoint\n";
+            cout << "12. Start/Stop Trajectory Export\n";
+            cout << "13. Start/Stop Route Query Server\n";
+            cout << "14. Route Query Server Statistics\n";
+            cout << "15. Exit Simulation\n";
 
             cout << "Enter your choice: ";
             int choice;
@@ -777,7 +2781,8 @@ public:
                     cout << "4. Calculate Shortest/Fastest Route\n";
                     cout << "5. Recalculate Routes Dynamically\n";
                     cout << "6. Track Vehicle Movement\n";
-                    cout << "7. Back to Main Menu\n";
+                    cout << "7. Equilibrium Traffic Assignment\n";
+                    cout << "8. Back to Main Menu\n";
                     cout << "Enter your choice: ";
                     int subChoice;
                     cin >> subChoice;
@@ -807,15 +2812,19 @@ public:
                         cout << "Calculate by:\n";
                         cout << "1. Shortest Distance\n";
                         cout << "2. Fastest Time\n";
+                        cout << "3. Fastest Time Including Signal Waits\n";
                         cout << "Enter your choice: ";
                         int calcType;
                         cin >> calcType;
 
                         if (calcType == 1) {
-                            dijkstra(src - BASE_CHAR, dest - BASE_CHAR, false); // Shortest path
+                            dijkstra(src - BASE_CHAR, dest - BASE_CHAR, SHORTEST_DISTANCE); // Shortest path
                         }
                         else if (calcType == 2) {
-                            dijkstra(src - BASE_CHAR, dest - BASE_CHAR, true); // Fastest route
+                            dijkstra(src - BASE_CHAR, dest - BASE_CHAR, FASTEST_TIME); // Fastest route
+                        }
+                        else if (calcType == 3) {
+                            dijkstra(src - BASE_CHAR, dest - BASE_CHAR, SIGNAL_AWARE_TIME); // Fastest, waiting at reds
                         }
                         else {
                             cout << "Invalid choice.\n";
@@ -829,6 +2838,9 @@ public:
                         simulateVehicleTracking(); // Track vehicle movement
                         break;
                     case 7:
+                        computeEquilibriumAssignment(); // Assign all vehicles' trips at once
+                        break;
+                    case 8:
                         cout << "Returning to main menu...\n";
                         break;
                     default:
@@ -836,7 +2848,7 @@ public:
                         break;
                     }
 
-                    if (subChoice == 7) break;
+                    if (subChoice == 8) break;
                 }
                 break;
             }
@@ -859,7 +2871,58 @@ public:
                 simulateEmergencyVehicleRouting();
                 break;
 
-            case 9:
+            case 9: {
+#ifdef SHARDING_SUPPORTED
+                int shardCount, ticks;
+                cout << "Enter number of shards and ticks: ";
+                cin >> shardCount >> ticks;
+                runShardedSimulation(shardCount, ticks);
+#else
+                cout << "Sharded simulation is not supported on this platform.\n";
+#endif
+                break;
+            }
+
+            case 10:
+                if (saveCheckpoint(CHECKPOINT_FILE)) {
+                    cout << "Checkpoint saved at tick " << simulationTick << " to " << CHECKPOINT_FILE << ".\n";
+                }
+                break;
+
+            case 11:
+                if (loadCheckpoint(CHECKPOINT_FILE)) {
+                    cout << "Checkpoint restored at tick " << simulationTick << " from " << CHECKPOINT_FILE << ".\n";
+                }
+                break;
+
+            case 12:
+                if (exporter == nullptr) startTrajectoryExport(TRAJECTORY_FILE);
+                else stopTrajectoryExport();
+                break;
+
+            case 13:
+#ifdef QUERY_SERVER_SUPPORTED
+                if (routeServer == nullptr) startRouteServer();
+                else stopRouteServer();
+#else
+                cout << "Route query server is not supported on this platform.\n";
+#endif
+                break;
+
+            case 14:
+#ifdef QUERY_SERVER_SUPPORTED
+                if (routeServer != nullptr) routeServer->printStatistics();
+                else cout << "Route query server is not running.\n";
+#else
+                cout << "Route query server is not supported on this platform.\n";
+#endif
+                break;
+
+            case 15:
+#ifdef QUERY_SERVER_SUPPORTED
+                stopRouteServer();
+#endif
+                stopTrajectoryExport();
                 cout << "Exiting Simulation...\n";
                 return;
 